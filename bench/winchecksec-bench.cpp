@@ -0,0 +1,268 @@
+#include <benchmark/benchmark.h>
+
+#include <checksec.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "cli/hash.h"
+#include "cli/render.h"
+#include "cli/store.h"
+#include "cli/walk.h"
+
+namespace {
+// NOTE: Overridden with --corpus=<dir>; defaults to the test assets.
+std::string corpus = WINCHECKSEC_BENCH_ASSETS;
+
+const char* const kImage = WINCHECKSEC_BENCH_ASSETS "/64/pegoat.exe";
+const char* const kSignedImage = WINCHECKSEC_BENCH_ASSETS "/64/pegoat-authenticode.exe";
+
+struct NullBuffer : std::streambuf {
+    int overflow(int c) override { return c; }
+};
+
+std::vector<std::uint8_t> slurp(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+void BM_LoadedImage(benchmark::State& state) {
+    auto mode = static_cast<checksec::LoadMode>(state.range(0));
+    for (auto _ : state) {
+        checksec::impl::LoadedImage image(kImage, mode);
+        benchmark::DoNotOptimize(image.get());
+    }
+}
+BENCHMARK(BM_LoadedImage)
+    ->Arg(static_cast<int>(checksec::LoadMode::Full))
+    ->Arg(static_cast<int>(checksec::LoadMode::HeadersOnly));
+
+void BM_ChecksecFromFile(benchmark::State& state) {
+    auto mode = static_cast<checksec::LoadMode>(state.range(0));
+    for (auto _ : state) {
+        checksec::Checksec checksec(kImage, mode);
+        benchmark::DoNotOptimize(&checksec);
+    }
+}
+BENCHMARK(BM_ChecksecFromFile)
+    ->Arg(static_cast<int>(checksec::LoadMode::Full))
+    ->Arg(static_cast<int>(checksec::LoadMode::HeadersOnly));
+
+// The constructor's parsing (headers, load config, debug directories) and evaluation, without
+// any I/O.
+void BM_ChecksecFromBuffer(benchmark::State& state) {
+    auto data = slurp(kImage);
+    for (auto _ : state) {
+        checksec::Checksec checksec(data.data(), data.size());
+        benchmark::DoNotOptimize(&checksec);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_ChecksecFromBuffer);
+
+template <const checksec::MitigationReport (checksec::Checksec::*Check)() const>
+void BM_Check(benchmark::State& state) {
+    checksec::Checksec checksec(kImage);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize((checksec.*Check)());
+    }
+}
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isDynamicBase);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isASLR);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isHighEntropyVA);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isForceIntegrity);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isIsolation);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isNX);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isSEH);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isCFG);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isRFG);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isSafeSEH);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isGS);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isDotNET);
+BENCHMARK_TEMPLATE(BM_Check, &checksec::Checksec::isCetCompat);
+
+// Authenticode verification is memoized, so each iteration needs a fresh instance. Parsing is
+// excluded from the timing.
+void BM_IsAuthenticode(benchmark::State& state) {
+    auto data = slurp(kSignedImage);
+    for (auto _ : state) {
+        state.PauseTiming();
+        checksec::Checksec checksec(data.data(), data.size());
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(checksec.isAuthenticode());
+    }
+}
+BENCHMARK(BM_IsAuthenticode);
+
+void BM_ToJson(benchmark::State& state) {
+    checksec::Checksec checksec(kImage);
+    for (auto _ : state) {
+        checksec::json j = checksec;
+        benchmark::DoNotOptimize(j.dump());
+    }
+}
+BENCHMARK(BM_ToJson);
+
+void BM_PrintText(benchmark::State& state) {
+    checksec::Checksec checksec(kImage);
+    for (auto _ : state) {
+        std::ostringstream os;
+        os << checksec;
+        benchmark::DoNotOptimize(os.str());
+    }
+}
+BENCHMARK(BM_PrintText);
+
+// The direct formatters, rendering into a reused buffer.
+void BM_RenderText(benchmark::State& state) {
+    auto result = checksec::cli::ScanResult::from(checksec::Checksec(kImage));
+    std::string out;
+    for (auto _ : state) {
+        out.clear();
+        checksec::cli::renderText(out, result);
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+BENCHMARK(BM_RenderText);
+
+void BM_RenderCSV(benchmark::State& state) {
+    auto result = checksec::cli::ScanResult::from(checksec::Checksec(kImage));
+    std::string out;
+    for (auto _ : state) {
+        out.clear();
+        checksec::cli::renderDelimited(out, kImage, result, ',');
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+BENCHMARK(BM_RenderCSV);
+
+// Content hashing, as used by --dedup and --cache-hash, over a buffer of state.range(0) bytes.
+void BM_ContentHash(benchmark::State& state) {
+    std::vector<std::uint8_t> data(static_cast<std::size_t>(state.range(0)));
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 131);
+    }
+    for (auto _ : state) {
+        checksec::cli::ContentHasher hasher;
+        hasher.update(data.data(), data.size());
+        benchmark::DoNotOptimize(hasher.digest());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ContentHash)->Arg(4 << 10)->Arg(1 << 20);
+
+// The deep GS scan's patterns, over pseudo-random code-like bytes.
+void BM_PatternScanner(benchmark::State& state) {
+    std::vector<std::uint8_t> data(static_cast<std::size_t>(state.range(0)));
+    std::uint32_t x = 0x9e3779b9;
+    for (auto& byte : data) {
+        x = x * 1664525 + 1013904223;
+        byte = static_cast<std::uint8_t>(x >> 24);
+    }
+    checksec::impl::PatternScanner scanner({
+        {{0x48, 0x8b, 0x05, 0, 0, 0, 0, 0x48, 0x33, 0xc4},
+         {0xfb, 0xff, 0xc7, 0, 0, 0, 0, 0xfb, 0xff, 0xc6},
+         10},
+        {{0x48, 0x33, 0xcc, 0xe8}, {0xff, 0xff, 0xfe, 0xff}, 4},
+    });
+    std::vector<checksec::impl::PatternScanner::Match> matches;
+    for (auto _ : state) {
+        matches.clear();
+        scanner.scan(data.data(), data.size(), matches);
+        benchmark::DoNotOptimize(matches.data());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PatternScanner)->Arg(64 << 10)->Arg(4 << 20);
+
+// End to end: files/sec (items_per_second) over every PE in the corpus, as the CLI scans them.
+void BM_Corpus(benchmark::State& state) {
+    std::vector<std::string> paths;
+    std::int64_t bytes = 0;
+    checksec::cli::DirectoryWalker walker(corpus);
+    while (auto path = walker.next()) {
+        if (checksec::cli::looksLikePE(*path)) {
+            bytes += static_cast<std::int64_t>(slurp(*path).size());
+            paths.push_back(std::move(*path));
+        }
+    }
+    if (paths.empty()) {
+        state.SkipWithError("no PEs found in the corpus");
+        return;
+    }
+
+    for (auto _ : state) {
+        for (const auto& path : paths) {
+            try {
+                checksec::json j = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+                benchmark::DoNotOptimize(j.dump());
+            } catch (checksec::ChecksecError&) {
+                // Malformed corpus members still cost something to reject.
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_Corpus)->Unit(benchmark::kMillisecond);
+
+// A two-column filter over a mapped result store of state.range(0) rows (items_per_second is
+// rows scanned). The rows cycle through every presence of every mitigation.
+void BM_StoreQuery(benchmark::State& state) {
+    auto rows = static_cast<std::size_t>(state.range(0));
+    auto path = (std::filesystem::temp_directory_path() / "winchecksec-bench.wcs").string();
+    {
+        checksec::cli::ResultStoreWriter writer;
+        for (std::size_t row = 0; row < rows; ++row) {
+            std::uint64_t bits = (row * 0x9e3779b97f4a7c15ULL) >> 8;
+            writer.add("C:\\Windows\\System32\\" + std::to_string(row) + ".dll",
+                       checksec::MitigationSummary(bits, 0));
+        }
+        std::ofstream file(path, std::ios::binary);
+        writer.write(file);
+    }
+
+    checksec::cli::ResultStore store(path);
+    checksec::cli::StoreQuery query("cfg=NotPresent && authenticode=Present");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(query.count(store));
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_StoreQuery)->Arg(1 << 20)->Arg(10 << 20)->Unit(benchmark::kMillisecond);
+}  // namespace
+
+int main(int argc, char** argv) {
+    // Pick out our own flag before handing the rest to the benchmark library.
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--corpus=", 9) == 0) {
+            corpus = argv[i] + 9;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    // NOTE: The checks warn about unusual load configs on stderr, which would otherwise
+    // drown out the results.
+    NullBuffer discard;
+    auto* previous = std::cerr.rdbuf(&discard);
+    benchmark::RunSpecifiedBenchmarks();
+
+    std::cerr.rdbuf(previous);
+    return 0;
+}
@@ -3,340 +3,1392 @@
 #include <pe-parse/parse.h>
 #include <uthenticode.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
 #include <ostream>
 #include <vector>
 #include <optional>
+#include <type_traits>
+#include <utility>
 
-#define REPORT_EXPLAIN(presence, description, explanation) \
-    { MitigationPresence::presence, impl::description, explanation }
-#define REPORT(presence, description) REPORT_EXPLAIN(presence, description, std::nullopt)
+// NOTE: Explanations are stored as small codes; resolving them in a constant expression
+// means that a typo'd or unregistered explanation is a compile error rather than a silent miss.
+#define SET_EXPLAIN(mitigation, presence, explanation)                                 \
+    summary_.set(Mitigation::mitigation, MitigationPresence::presence,                 \
+                 std::integral_constant<std::uint8_t,                                  \
+                                        impl::explanationCode(Mitigation::mitigation,  \
+                                                              impl::explanation)>::value)
+#define SET(mitigation, presence) summary_.set(Mitigation::mitigation, MitigationPresence::presence)
 
 namespace checksec {
 
-Checksec::Checksec(std::string filepath) : filepath_(filepath), loadedImage_(filepath) {
+namespace impl {
+namespace {
+// The data directories that a header-only load can read, when a check needs them. Everything
+// else that pe-parse would otherwise parse (imports, exports, resources, relocations) is left
+// out.
+constexpr peparse::data_directory_kind kHeaderOnlyDirectories[] = {
+    peparse::DIR_LOAD_CONFIG,
+    peparse::DIR_DEBUG,
+};
+
+// The checks that need the load config, and the debug directories, to be parsed.
+constexpr CheckMask kLoadConfigChecks =
+    checkMask(Mitigation::RFG) | checkMask(Mitigation::SafeSEH) | checkMask(Mitigation::GS) |
+    checkMask(Mitigation::CFGTable) | checkMask(Mitigation::XFG) |
+    checkMask(Mitigation::EHContinuation);
+constexpr CheckMask kDebugDirectoryChecks =
+    checkMask(Mitigation::CetCompat) | checkMask(Mitigation::CetStrict);
+
+// GuardFlags bits, from winnt.h.
+constexpr std::uint32_t kGuardCFInstrumented = 0x00000100;
+constexpr std::uint32_t kGuardCFFunctionTablePresent = 0x00000400;
+constexpr std::uint32_t kGuardEHContinuationTablePresent = 0x00400000;
+constexpr std::uint32_t kGuardXFGEnabled = 0x00800000;
+constexpr unsigned kGuardCFFunctionTableSizeShift = 28;
+
+// IMAGE_DLLCHARACTERISTICS_EX_CET_COMPAT_STRICT_MODE, which pe-parse doesn't define.
+constexpr std::uint16_t kDllCharacteristicsExCetCompatStrictMode = 0x0002;
+
+/**
+ * The offsets of the load config fields that come after pe-parse's load config structures,
+ * along with the sizes that a load config needs to contain each group of fields.
+ */
+struct LoadConfigLayout {
+    std::size_t pointerSize;
+    std::size_t guardCFFunctionTableSize;
+    std::size_t guardEHContinuationTable;
+    std::size_t guardEHContinuationCount;
+    std::size_t guardXFGCheckFunctionPointer;
+};
+
+// NOTE: The CFG fields end with GuardFlags; the EH continuation and XFG fields were added
+// in later SDKs. See:
+// https://docs.microsoft.com/en-us/windows/win32/debug/pe-format#load-configuration-layout
+constexpr LoadConfigLayout kLoadConfigLayout32 = {4, 92, 164, 168, 172};
+constexpr LoadConfigLayout kLoadConfigLayout64 = {8, 148, 264, 272, 280};
+
+std::uint64_t readField(const std::vector<std::uint8_t>& data, std::size_t offset,
+                        std::size_t size) {
+    std::uint64_t value = 0;
+    if (offset + size <= data.size()) {
+        for (std::size_t i = 0; i < size; ++i) {
+            value |= static_cast<std::uint64_t>(data[offset + i]) << (8 * i);
+        }
+    }
+    return value;
+}
+
+// The patterns that gsInstrumentation() scans for. MSVC keys the cookie with the stack (or frame)
+// pointer in the prologue, and un-keys it in the epilogue before passing it (in ecx/rcx) to
+// __security_check_cookie.
+enum GSPattern : std::size_t {
+    kGSCookieLoad,
+    kGSCookieLoadAbsolute,
+    kGSCookieCheck,
+    kGSFramePrologue,
+};
+
+BytePattern bytePattern(std::initializer_list<std::uint8_t> value,
+                        std::initializer_list<std::uint8_t> mask) {
+    BytePattern pattern{};
+    std::copy(value.begin(), value.end(), pattern.value);
+    std::copy(mask.begin(), mask.end(), pattern.mask);
+    pattern.size = value.size();
+    return pattern;
+}
+
+std::vector<std::pair<GSPattern, BytePattern>> gsPatterns(bool is64Bit, std::uint32_t cookie) {
+    std::uint8_t c[4] = {static_cast<std::uint8_t>(cookie), static_cast<std::uint8_t>(cookie >> 8),
+                         static_cast<std::uint8_t>(cookie >> 16),
+                         static_cast<std::uint8_t>(cookie >> 24)};
+    if (is64Bit) {
+        // NOTE: The cookie is loaded RIP-relative, so its displacement can't be part of the
+        // pattern; matches are checked against the cookie's address instead.
+        return {
+            // mov r64, [rip + disp32]; xor r64, rsp/rbp
+            {kGSCookieLoad, bytePattern({0x48, 0x8b, 0x05, 0, 0, 0, 0, 0x48, 0x33, 0xc4},
+                                        {0xfb, 0xff, 0xc7, 0, 0, 0, 0, 0xfb, 0xff, 0xc6})},
+            // xor rcx, rsp/rbp; call rel32
+            {kGSCookieCheck, bytePattern({0x48, 0x33, 0xcc, 0xe8}, {0xff, 0xff, 0xfe, 0xff})},
+        };
+    }
+
+    return {
+        // mov r32, [cookie]; xor r32, esp/ebp
+        {kGSCookieLoad, bytePattern({0x8b, 0x05, c[0], c[1], c[2], c[3], 0x33, 0xc4},
+                                    {0xff, 0xc7, 0xff, 0xff, 0xff, 0xff, 0xff, 0xc6})},
+        // mov eax, [cookie]; xor eax, esp/ebp
+        {kGSCookieLoadAbsolute, bytePattern({0xa1, c[0], c[1], c[2], c[3], 0x33, 0xc4},
+                                            {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe})},
+        // xor ecx, esp/ebp; call rel32
+        {kGSCookieCheck, bytePattern({0x33, 0xcc, 0xe8}, {0xff, 0xfe, 0xff})},
+        // push ebp; mov ebp, esp
+        {kGSFramePrologue, bytePattern({0x55, 0x8b, 0xec}, {0xff, 0xff, 0xff})},
+    };
+}
+
+// Data directories that a header-only load leaves intact in the header without reading: the
+// checks only look at their presence.
+constexpr peparse::data_directory_kind kHeaderOnlyReferencedDirectories[] = {
+    peparse::DIR_SECURITY,
+    peparse::DIR_COM_DESCRIPTOR,
+};
+
+std::uint16_t read16(const std::uint8_t* p) { return p[0] | (p[1] << 8); }
+
+std::uint32_t read32(const std::uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+std::uint64_t read64(const std::uint8_t* p) {
+    return read32(p) | (static_cast<std::uint64_t>(read32(p + 4)) << 32);
+}
+
+// The sizes of IMAGE_IMPORT_DESCRIPTOR and IMAGE_DELAYLOAD_DESCRIPTOR.
+constexpr std::size_t kImportDescriptorSize = 20;
+constexpr std::size_t kDelayImportDescriptorSize = 32;
+
+// The delay-load descriptor attribute that says its addresses are RVAs rather than VAs.
+constexpr std::uint32_t kDelayImportRvaBased = 0x1;
+
+/**
+ * Charges the time between its construction and destruction to a phase.
+ *
+ * Phases nest exclusively: an inner phase pauses the enclosing one (on the same thread), so
+ * that no time is counted twice.
+ */
+class ScopedPhase {
+   public:
+    ScopedPhase(PhaseTimings& timings, Phase phase)
+        : timings_(timings), phase_(phase), parent_(current), start_(now()) {
+        ScopedDeadline::check();
+        if (parent_) {
+            parent_->charge(start_);
+        }
+        current = this;
+    }
+
+    ~ScopedPhase() {
+        auto end = now();
+        charge(end);
+        if (parent_) {
+            parent_->start_ = end;
+        }
+        current = parent_;
+    }
+
+    // can't make copies of ScopedPhase
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+   private:
+    using clock = std::chrono::steady_clock;
+
+    static clock::time_point now() { return clock::now(); }
+
+    void charge(clock::time_point until) {
+        timings_.nanoseconds[static_cast<std::size_t>(phase_)] +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(until - start_).count();
+    }
+
+    static thread_local ScopedPhase* current;
+
+    PhaseTimings& timings_;
+    Phase phase_;
+    ScopedPhase* parent_;
+    clock::time_point start_;
+};
+
+thread_local ScopedPhase* ScopedPhase::current = nullptr;
+
+thread_local std::optional<std::chrono::steady_clock::time_point> deadline;
+thread_local const std::atomic<bool>* cancelled = nullptr;
+
+template <std::size_t N>
+bool contains(const peparse::data_directory_kind (&kinds)[N], std::uint32_t kind) {
+    return std::find(std::begin(kinds), std::end(kinds), kind) != std::end(kinds);
+}
+
+// Finds the file offset of `rva` from a raw section table.
+std::optional<std::uint64_t> sectionOffset(const std::uint8_t* sectionTable,
+                                           std::uint16_t numberOfSections, std::uint32_t rva) {
+    for (std::uint16_t i = 0; i < numberOfSections; ++i) {
+        const std::uint8_t* section = sectionTable + i * 40ull;
+        std::uint32_t virtualSize = read32(section + 8);
+        std::uint32_t virtualAddress = read32(section + 12);
+        std::uint32_t sizeOfRawData = read32(section + 16);
+        std::uint32_t pointerToRawData = read32(section + 20);
+        std::uint64_t extent = std::max(virtualSize, sizeOfRawData);
+        if (rva >= virtualAddress && rva < virtualAddress + extent) {
+            return static_cast<std::uint64_t>(pointerToRawData) + (rva - virtualAddress);
+        }
+    }
+
+    return std::nullopt;
+}
+}  // namespace
+
+LoadedImage::LoadedImage(const std::string path, LoadMode mode) : mode_(mode) {
+    if (mode_ == LoadMode::HeadersOnly) {
+        {
+            ScopedPhase phase(timings_, Phase::IO);
+            file_.open(path, std::ios::binary);
+            if (file_ && file_.seekg(0, std::ios::end)) {
+                size_ = static_cast<std::uint64_t>(file_.tellg());
+            }
+        }
+
+        // NOTE: The buffer spans the whole file but starts out zeroed; only the ranges we
+        // actually need get read into it. Large zeroed allocations are backed lazily by the OS,
+        // so the untouched parts of the image cost neither I/O nor resident memory.
+        if (size_ > 0 && size_ <= std::numeric_limits<std::uint32_t>::max()) {
+            buffer_ = static_cast<std::uint8_t*>(std::calloc(size_, 1));
+        }
+
+        // NOTE: A deadline can pass midway through, and the destructor won't run for a
+        // constructor that throws.
+        try {
+            if (buffer_ && loadHeaders()) {
+                ScopedPhase phase(timings_, Phase::Parse);
+                pe_ = peparse::ParsePEFromPointer(buffer_, static_cast<std::uint32_t>(size_));
+            }
+        } catch (...) {
+            release();
+            throw;
+        }
+
+        if (pe_) {
+            return;
+        }
+
+        // Anything unexpected in the headers: let pe-parse have the final say on the full file.
+        std::free(buffer_);
+        buffer_ = nullptr;
+        file_.close();
+        mode_ = LoadMode::Full;
+    }
+
+    // NOTE: pe-parse reads the file itself, so its I/O can't be separated from parsing.
+    ScopedPhase phase(timings_, Phase::Parse);
+    if (!(pe_ = peparse::ParsePEFromFile(path.c_str()))) {
+        throw ChecksecError("Couldn't load file; corrupt or not a PE?");
+    }
+    timings_.bytesRead += pe_->fileBuffer->bufLen;
+}
+
+LoadedImage::LoadedImage(const std::uint8_t* data, std::size_t size) : mode_(LoadMode::Full) {
+    if (data == nullptr || size > std::numeric_limits<std::uint32_t>::max()) {
+        throw ChecksecError("Couldn't load buffer; corrupt or not a PE?");
+    }
+
+    // NOTE: pe-parse only ever reads through this pointer, and doesn't take ownership of it.
+    ScopedPhase phase(timings_, Phase::Parse);
+    if (!(pe_ = peparse::ParsePEFromPointer(const_cast<std::uint8_t*>(data),
+                                            static_cast<std::uint32_t>(size)))) {
+        throw ChecksecError("Couldn't load buffer; corrupt or not a PE?");
+    }
+}
+
+LoadedImage::~LoadedImage() { release(); }
+
+bool LoadedImage::fetch(std::uint64_t offset, std::uint64_t size) {
+    if (mode_ == LoadMode::Full) {
+        return offset < pe_->fileBuffer->bufLen;
+    }
+
+    if (offset >= size_) {
+        return false;
+    }
+
+    ScopedPhase phase(timings_, Phase::IO);
+    size = std::min(size, size_ - offset);
+    file_.clear();
+    bool ok = file_.seekg(offset) && file_.read(reinterpret_cast<char*>(buffer_ + offset),
+                                                static_cast<std::streamsize>(size));
+    timings_.bytesRead += static_cast<std::uint64_t>(std::max<std::streamsize>(file_.gcount(), 0));
+    return ok;
+}
+
+void LoadedImage::release() {
+    if (pe_ != nullptr) {
+        peparse::DestructParsedPE(pe_);
+        pe_ = nullptr;
+    }
+    std::free(buffer_);
+    buffer_ = nullptr;
+    file_.close();
+    fetchedSections_.clear();
+    fetchedSections_.shrink_to_fit();
+}
+
+void LoadedImage::loadFull() {
+    if (mode_ == LoadMode::Full) {
+        return;
+    }
+
+    if (!fetch(0, size_)) {
+        throw ChecksecError("Couldn't read the rest of the file");
+    }
+
+    // NOTE: pe-parse doesn't own our buffer, so destroying the partial parse leaves the
+    // (now complete) bytes intact for the full one.
+    ScopedPhase phase(timings_, Phase::Parse);
+    peparse::DestructParsedPE(pe_);
+    if (!(pe_ = peparse::ParsePEFromPointer(buffer_, static_cast<std::uint32_t>(size_)))) {
+        throw ChecksecError("Couldn't load file; corrupt or not a PE?");
+    }
+    file_.close();
+    mode_ = LoadMode::Full;
+}
+
+bool LoadedImage::loadHeaders() {
+    if (!fetch(0, kHeaderReadSize) || size_ < 0x40 || buffer_[0] != 'M' || buffer_[1] != 'Z') {
+        return false;
+    }
+
+    std::uint64_t ntHeaders = read32(buffer_ + 0x3c);
+    if (ntHeaders + 24 > size_ || !fetch(ntHeaders, 24) || read32(buffer_ + ntHeaders) != 0x4550) {
+        return false;
+    }
+
+    numberOfSections_ = read16(buffer_ + ntHeaders + 6);
+    std::uint64_t optionalHeader = ntHeaders + 24;
+    sectionTable_ = optionalHeader + read16(buffer_ + ntHeaders + 20);
+    std::uint64_t headersEnd = sectionTable_ + numberOfSections_ * 40ull;
+    if (headersEnd > size_ || !fetch(optionalHeader, headersEnd - optionalHeader)) {
+        return false;
+    }
+
+    std::uint64_t dataDirectories;
+    std::uint32_t numberOfRvaAndSizes;
+    switch (read16(buffer_ + optionalHeader)) {
+        case peparse::NT_OPTIONAL_32_MAGIC: {
+            numberOfRvaAndSizes = read32(buffer_ + optionalHeader + 92);
+            dataDirectories = optionalHeader + 96;
+            break;
+        }
+        case peparse::NT_OPTIONAL_64_MAGIC: {
+            numberOfRvaAndSizes = read32(buffer_ + optionalHeader + 108);
+            dataDirectories = optionalHeader + 112;
+            break;
+        }
+        default: {
+            return false;
+        }
+    }
+    numberOfRvaAndSizes = std::min<std::uint32_t>(numberOfRvaAndSizes, 16);
+    if (dataDirectories + numberOfRvaAndSizes * 8ull > headersEnd) {
+        return false;
+    }
+
+    // NOTE: The directories that the checks might need are left for fetchDirectory, which
+    // reads them only if they're actually parsed.
+    dataDirectories_ = dataDirectories;
+    for (std::uint32_t kind = 0; kind < numberOfRvaAndSizes; ++kind) {
+        std::uint8_t* entry = buffer_ + dataDirectories + kind * 8;
+        directories_[kind] = {read32(entry), read32(entry + 4)};
+        if (!contains(kHeaderOnlyDirectories, kind) &&
+            !contains(kHeaderOnlyReferencedDirectories, kind)) {
+            // Hide the directories we won't read from pe-parse, so that it doesn't try to parse
+            // their (zeroed) contents.
+            std::memset(entry, 0, 8);
+        }
+    }
+
+    // Ditto for the COFF symbol table.
+    std::memset(buffer_ + ntHeaders + 12, 0, 8);
+
+    return true;
+}
+
+void LoadedImage::fetchDirectory(peparse::data_directory_kind kind) {
+    if (mode_ == LoadMode::Full || !contains(kHeaderOnlyDirectories, kind)) {
+        return;
+    }
+
+    const std::uint8_t* entry = buffer_ + dataDirectories_ + kind * 8;
+    std::uint32_t rva = read32(entry);
+    std::uint32_t size = read32(entry + 4);
+    if (auto offset = rvaToOffset(rva); offset && size != 0) {
+        fetch(*offset, size);
+    }
+}
+
+std::optional<std::uint64_t> LoadedImage::fileRange(std::uint32_t rva, std::uint64_t size) const {
+    struct Search {
+        std::uint64_t rva;
+        std::uint64_t size;
+        std::optional<std::uint64_t> offset;
+    } search{rva, size, std::nullopt};
+
+    peparse::IterSec(
+        pe_,
+        [](void* cbd, const peparse::VA&, const std::string&,
+           const peparse::image_section_header& section, const peparse::bounded_buffer*) {
+            auto* search = static_cast<Search*>(cbd);
+            std::uint64_t start = section.VirtualAddress;
+            if (search->rva < start || search->rva - start >= section.SizeOfRawData) {
+                return 0;
+            }
+            if (search->size <= section.SizeOfRawData - (search->rva - start)) {
+                search->offset = section.PointerToRawData + (search->rva - start);
+            }
+            return 1;
+        },
+        &search);
+
+    if (!search.offset || *search.offset + size > pe_->fileBuffer->bufLen) {
+        return std::nullopt;
+    }
+    return search.offset;
+}
+
+peparse::data_directory LoadedImage::directory(peparse::data_directory_kind kind) const {
+    if (mode_ == LoadMode::HeadersOnly) {
+        return kind < std::size(directories_) ? directories_[kind] : peparse::data_directory{0};
+    }
+
+    const auto& nt = pe_->peHeader.nt;
+    bool is64Bit = nt.OptionalMagic == peparse::NT_OPTIONAL_64_MAGIC;
+    std::uint32_t numberOfRvaAndSizes = std::min<std::uint32_t>(
+        is64Bit ? nt.OptionalHeader64.NumberOfRvaAndSizes : nt.OptionalHeader.NumberOfRvaAndSizes,
+        16);
+    if (kind >= numberOfRvaAndSizes) {
+        return {0};
+    }
+    return is64Bit ? nt.OptionalHeader64.DataDirectory[kind]
+                   : nt.OptionalHeader.DataDirectory[kind];
+}
+
+std::pair<const std::uint8_t*, std::size_t> LoadedImage::sectionData(std::uint32_t rva) {
+    struct Search {
+        std::uint32_t rva;
+        std::size_t index;
+        std::uint64_t start;
+        std::uint64_t size;
+        std::uint64_t offset;
+        bool found;
+    } search{rva, 0, 0, 0, 0, false};
+
+    peparse::IterSec(
+        pe_,
+        [](void* cbd, const peparse::VA&, const std::string&,
+           const peparse::image_section_header& section, const peparse::bounded_buffer*) {
+            auto* search = static_cast<Search*>(cbd);
+            std::uint32_t start = section.VirtualAddress;
+            if (search->rva < start || search->rva - start >= section.SizeOfRawData) {
+                ++search->index;
+                return 0;
+            }
+            search->start = section.PointerToRawData;
+            search->size = section.SizeOfRawData;
+            search->offset = section.PointerToRawData + (search->rva - start);
+            search->found = true;
+            return 1;
+        },
+        &search);
+
+    std::uint64_t fileSize = pe_->fileBuffer->bufLen;
+    if (!search.found || search.offset >= fileSize) {
+        return {nullptr, 0};
+    }
+    std::uint64_t end = std::min(search.start + search.size, fileSize);
+
+    // NOTE: Import tables (and the names they point at) are scattered across their section,
+    // so the section is read in one go rather than one name at a time.
+    if (mode_ == LoadMode::HeadersOnly) {
+        if (search.index >= fetchedSections_.size()) {
+            fetchedSections_.resize(search.index + 1);
+        }
+        if (!fetchedSections_[search.index]) {
+            fetch(search.start, end - search.start);
+            fetchedSections_[search.index] = true;
+        }
+    }
+
+    return {pe_->fileBuffer->buf + search.offset, static_cast<std::size_t>(end - search.offset)};
+}
+
+std::optional<std::uint64_t> LoadedImage::rvaToOffset(std::uint32_t rva) const {
+    return sectionOffset(buffer_ + sectionTable_, numberOfSections_, rva);
+}
+}  // namespace impl
+
+ScopedDeadline::ScopedDeadline(std::chrono::steady_clock::time_point deadline)
+    : previous_(impl::deadline), previousCancelled_(impl::cancelled) {
+    impl::deadline = deadline;
+}
+
+ScopedDeadline::ScopedDeadline(std::optional<std::chrono::steady_clock::time_point> deadline,
+                               const std::atomic<bool>& cancelled)
+    : previous_(impl::deadline), previousCancelled_(impl::cancelled) {
+    impl::deadline = deadline;
+    impl::cancelled = &cancelled;
+}
+
+ScopedDeadline::~ScopedDeadline() {
+    impl::deadline = previous_;
+    impl::cancelled = previousCancelled_;
+}
+
+void ScopedDeadline::check() {
+    if (impl::cancelled && impl::cancelled->load(std::memory_order_relaxed)) {
+        throw TimeoutError("Scan cancelled");
+    }
+    if (impl::deadline && std::chrono::steady_clock::now() >= *impl::deadline) {
+        throw TimeoutError();
+    }
+}
+
+Checksec::Checksec(std::string filepath, LoadMode mode, CheckMask checks)
+    : loadedImage_(filepath, mode), filepath_(filepath), checks_(checks) {
+    parse();
+    evaluate();
+}
+
+Checksec::Checksec(const std::uint8_t* data, std::size_t size, std::string label,
+                   CheckMask checks)
+    : loadedImage_(data, size), filepath_(std::move(label)), checks_(checks) {
+    parse();
+    evaluate();
+}
+
+std::vector<impl::FileRange> Checksec::plannedReads(const std::uint8_t* headers,
+                                                    std::size_t size, std::uint64_t fileSize,
+                                                    CheckMask checks) {
+    using impl::read16;
+    using impl::read32;
+
+    // NOTE: This follows LoadedImage::loadHeaders, but never reads anything itself: a
+    // malformed image just gets no predictions, and the scan finds out what's wrong with it.
+    std::vector<impl::FileRange> ranges;
+    if (size < 0x40 || headers[0] != 'M' || headers[1] != 'Z') {
+        return ranges;
+    }
+
+    std::uint64_t ntHeaders = read32(headers + 0x3c);
+    if (ntHeaders + 24 > size || read32(headers + ntHeaders) != 0x4550) {
+        return ranges;
+    }
+
+    std::uint16_t numberOfSections = read16(headers + ntHeaders + 6);
+    std::uint64_t optionalHeader = ntHeaders + 24;
+    std::uint64_t sectionTable = optionalHeader + read16(headers + ntHeaders + 20);
+    std::uint64_t headersEnd = sectionTable + numberOfSections * 40ull;
+    if (headersEnd > fileSize) {
+        return ranges;
+    }
+    if (headersEnd > size) {
+        ranges.push_back({size, headersEnd - size});
+        return ranges;
+    }
+
+    std::uint64_t dataDirectories;
+    std::uint32_t numberOfRvaAndSizes;
+    switch (read16(headers + optionalHeader)) {
+        case peparse::NT_OPTIONAL_32_MAGIC: {
+            numberOfRvaAndSizes = read32(headers + optionalHeader + 92);
+            dataDirectories = optionalHeader + 96;
+            break;
+        }
+        case peparse::NT_OPTIONAL_64_MAGIC: {
+            numberOfRvaAndSizes = read32(headers + optionalHeader + 108);
+            dataDirectories = optionalHeader + 112;
+            break;
+        }
+        default: {
+            return ranges;
+        }
+    }
+    numberOfRvaAndSizes = std::min<std::uint32_t>(numberOfRvaAndSizes, 16);
+    if (dataDirectories + numberOfRvaAndSizes * 8ull > headersEnd) {
+        return ranges;
+    }
+
+    auto directory = [&](peparse::data_directory_kind kind) {
+        if (kind >= numberOfRvaAndSizes) {
+            return peparse::data_directory{0};
+        }
+        const std::uint8_t* entry = headers + dataDirectories + kind * 8;
+        return peparse::data_directory{read32(entry), read32(entry + 4)};
+    };
+
+    // A signed image is read (and hashed) in full, which covers everything else.
+    auto security = directory(peparse::DIR_SECURITY);
+    if ((checks & checkMask(Mitigation::Authenticode)) && security.VirtualAddress != 0 &&
+        security.Size != 0) {
+        ranges.push_back({0, fileSize});
+        return ranges;
+    }
+
+    auto plan = [&](peparse::data_directory_kind kind) {
+        auto dir = directory(kind);
+        if (dir.Size == 0) {
+            return;
+        }
+        auto offset = impl::sectionOffset(headers + sectionTable, numberOfSections,
+                                          dir.VirtualAddress);
+        if (offset && *offset < fileSize) {
+            ranges.push_back({*offset, std::min<std::uint64_t>(dir.Size, fileSize - *offset)});
+        }
+    };
+    if (checks & impl::kLoadConfigChecks) {
+        plan(peparse::DIR_LOAD_CONFIG);
+    }
+    if (checks & impl::kDebugDirectoryChecks) {
+        plan(peparse::DIR_DEBUG);
+    }
+
+    return ranges;
+}
+
+void Checksec::parse() {
+    // NOTE: Everything up to the debug directories is charged to the load config.
+    std::optional<impl::ScopedPhase> phase;
+    phase.emplace(loadedImage_.timings(), Phase::LoadConfig);
+
     peparse::nt_header_32 nt = loadedImage_.get()->peHeader.nt;
     peparse::file_header* imageFileHeader = &(nt.FileHeader);
 
     targetMachine_ = imageFileHeader->Machine;
     imageCharacteristics_ = imageFileHeader->Characteristics;
-    std::vector<std::uint8_t> loadConfigData;
-    std::vector<std::uint8_t> debugDirectories;
 
     // Check whether we need a 32 or 32+ optional header.
+    std::uint32_t numberOfRvaAndSizes;
+    const peparse::data_directory* dataDirectories;
     if (nt.OptionalMagic == peparse::NT_OPTIONAL_64_MAGIC) {
-        peparse::optional_header_64* optionalHeader = &(nt.OptionalHeader64);
-        dllCharacteristics_ = optionalHeader->DllCharacteristics;
-        if (optionalHeader->NumberOfRvaAndSizes < peparse::DIR_COM_DESCRIPTOR + 1) {
-            std::cerr << "Warn: short image data directory vector (no CLR info?)"
-                      << "\n";
-            return;
-        }
-        clrConfig_ = optionalHeader->DataDirectory[peparse::DIR_COM_DESCRIPTOR];
+        is64Bit_ = true;
+        imageBase_ = nt.OptionalHeader64.ImageBase;
+        dllCharacteristics_ = nt.OptionalHeader64.DllCharacteristics;
+        numberOfRvaAndSizes = nt.OptionalHeader64.NumberOfRvaAndSizes;
+        dataDirectories = nt.OptionalHeader64.DataDirectory;
+    } else {
+        imageBase_ = nt.OptionalHeader.ImageBase;
+        dllCharacteristics_ = nt.OptionalHeader.DllCharacteristics;
+        numberOfRvaAndSizes = nt.OptionalHeader.NumberOfRvaAndSizes;
+        dataDirectories = nt.OptionalHeader.DataDirectory;
+    }
 
-        // Warn and return early if the image data directory vector
-        // is too short to contain a reference to the DIR_LOAD_CONFIG.
-        if (optionalHeader->NumberOfRvaAndSizes < peparse::DIR_LOAD_CONFIG + 1) {
-            std::cerr << "Warn: short image data directory vector (no load config?)"
-                      << "\n";
-            return;
-        }
+    if (numberOfRvaAndSizes > peparse::DIR_SECURITY) {
+        securityDir_ = dataDirectories[peparse::DIR_SECURITY];
+    }
+    if (numberOfRvaAndSizes < peparse::DIR_COM_DESCRIPTOR + 1) {
+        std::cerr << "Warn: short image data directory vector (no CLR info?)"
+                  << "\n";
+        return;
+    }
+    clrConfig_ = dataDirectories[peparse::DIR_COM_DESCRIPTOR];
 
-        if (!peparse::GetDataDirectoryEntry(loadedImage_.get(), peparse::DIR_LOAD_CONFIG,
-                                            loadConfigData)) {
-            std::cerr << "Warn: No load config in the PE"
-                      << "\n";
-            return;
-        }
-        peparse::image_load_config_64 loadConfig{};
-        if (loadConfigData.size() > sizeof(loadConfig)) {
-            std::cerr << "Warn: large load config, probably contains undocumented "
-                         "fields"
-                      << "\n";
-        } else if (loadConfigData.size() < sizeof(loadConfig)) {
-            std::cerr << "Warn: undersized load config, probably missing fields"
-                      << "\n";
-        }
-        auto size = std::min(loadConfigData.size(), sizeof(loadConfig));
-        memcpy(&loadConfig, loadConfigData.data(), size);
-        loadConfigSize_ = loadConfigData.size();
-        loadConfigGuardFlags_ = loadConfig.GuardFlags;
-        loadConfigSecurityCookie_ = loadConfig.SecurityCookie;
-        loadConfigSEHandlerTable_ = loadConfig.SEHandlerTable;
-        loadConfigSEHandlerCount_ = loadConfig.SEHandlerCount;
-
-        // Iterate over debug directories
-        if (!peparse::GetDataDirectoryEntry(loadedImage_.get(), peparse::DIR_DEBUG,
-                                            debugDirectories)) {
-            std::cerr << "Warn: No debug directories"
-                      << "\n";
-            return;
+    // NOTE: The data directories are only parsed (and, for a partially loaded image, read)
+    // when one of the selected checks needs them.
+    if (checks_ & impl::kLoadConfigChecks) {
+        if (is64Bit_) {
+            parseLoadConfig<peparse::image_load_config_64>();
+        } else {
+            parseLoadConfig<peparse::image_load_config_32>();
         }
+    }
+
+    if (checks_ & impl::kDebugDirectoryChecks) {
+        phase.reset();
+        phase.emplace(loadedImage_.timings(), Phase::DebugDirectories);
+        parseDebugDirectories();
+    }
+}
+
+template <typename LoadConfig>
+void Checksec::parseLoadConfig() {
+    std::vector<std::uint8_t> loadConfigData;
+    loadedImage_.fetchDirectory(peparse::DIR_LOAD_CONFIG);
+    if (!peparse::GetDataDirectoryEntry(loadedImage_.get(), peparse::DIR_LOAD_CONFIG,
+                                        loadConfigData)) {
+        std::cerr << "Warn: No load config in the PE"
+                  << "\n";
+        return;
+    }
+
+    LoadConfig loadConfig{};
+    if (loadConfigData.size() > sizeof(loadConfig)) {
+        std::cerr << "Warn: large load config, probably contains undocumented "
+                     "fields"
+                  << "\n";
+    } else if (loadConfigData.size() < sizeof(loadConfig)) {
+        std::cerr << "Warn: undersized load config, probably missing fields"
+                  << "\n";
+    }
+    auto size = std::min(loadConfigData.size(), sizeof(loadConfig));
+    memcpy(&loadConfig, loadConfigData.data(), size);
+    loadConfigSize_ = loadConfigData.size();
+    loadConfigGuardFlags_ = loadConfig.GuardFlags;
+    loadConfigSecurityCookie_ = loadConfig.SecurityCookie;
+    loadConfigSEHandlerTable_ = loadConfig.SEHandlerTable;
+    loadConfigSEHandlerCount_ = loadConfig.SEHandlerCount;
+
+    // NOTE: The guard tables themselves aren't read here: they're only located (and
+    // bounds-checked), and then viewed in place if they're asked for.
+    const auto& layout = is64Bit_ ? impl::kLoadConfigLayout64 : impl::kLoadConfigLayout32;
+    if (loadConfigData.size() >= layout.guardCFFunctionTableSize) {
+        loadConfigGuardCFFunctionCount_ = loadConfig.GuardCFFunctionCount;
+        guardCFFunctionTableOffset_ =
+            locateGuardTable(loadConfig.GuardCFFunctionTable, loadConfigGuardCFFunctionCount_);
+    }
+    loadConfigGuardEHContinuationCount_ =
+        impl::readField(loadConfigData, layout.guardEHContinuationCount, layout.pointerSize);
+    guardEHContinuationTableOffset_ = locateGuardTable(
+        impl::readField(loadConfigData, layout.guardEHContinuationTable, layout.pointerSize),
+        loadConfigGuardEHContinuationCount_);
+    loadConfigGuardXFGCheckFunctionPointer_ =
+        impl::readField(loadConfigData, layout.guardXFGCheckFunctionPointer, layout.pointerSize);
+}
+
+std::optional<std::uint64_t> Checksec::locateGuardTable(std::uint64_t va,
+                                                        std::uint64_t count) const {
+    // NOTE: Tables are addressed by VA, and each entry is at most 4 + 15 bytes, so a table
+    // with more than 2^32 / 4 entries can't fit in an image anyway.
+    std::uint64_t stride = 4 + (loadConfigGuardFlags_ >> impl::kGuardCFFunctionTableSizeShift);
+    if (va < imageBase_ || va - imageBase_ > std::numeric_limits<std::uint32_t>::max() ||
+        count == 0 || count > std::numeric_limits<std::uint32_t>::max() / 4) {
+        return std::nullopt;
+    }
+    return loadedImage_.fileRange(static_cast<std::uint32_t>(va - imageBase_), count * stride);
+}
+
+GuardTable Checksec::guardTable(std::optional<std::uint64_t> offset, std::uint64_t count) const {
+    if (!offset || loadedImage_.get() == nullptr) {
+        return {};
+    }
+
+    std::size_t stride = 4 + (loadConfigGuardFlags_ >> impl::kGuardCFFunctionTableSizeShift);
+    if (!loadedImage_.fetch(*offset, count * stride)) {
+        return {};
+    }
+    return GuardTable(loadedImage_.get()->fileBuffer->buf + *offset,
+                      static_cast<std::size_t>(count), stride);
+}
+
+GuardTable Checksec::guardCFFunctionTable() const {
+    return guardTable(guardCFFunctionTableOffset_, loadConfigGuardCFFunctionCount_);
+}
+
+GuardTable Checksec::guardEHContinuationTable() const {
+    return guardTable(guardEHContinuationTableOffset_, loadConfigGuardEHContinuationCount_);
+}
+
+std::optional<GSInstrumentation> Checksec::gsInstrumentation() const {
+    if (gsScanned_) {
+        return gsInstrumentation_;
+    }
+    gsScanned_ = true;
+    bool is64Bit = targetMachine_ == peparse::IMAGE_FILE_MACHINE_AMD64;
+    if (!(checks_ & checkMask(Mitigation::GS)) || loadedImage_.get() == nullptr ||
+        (!is64Bit && targetMachine_ != peparse::IMAGE_FILE_MACHINE_I386)) {
+        return std::nullopt;
+    }
+
+    impl::ScopedPhase phase(loadedImage_.timings(), Phase::CodeScan);
+    loadedImage_.loadFull();
+
+    // NOTE: A cookie outside of the image can't be loaded by any instruction we'd match.
+    std::uint64_t cookieRva = loadConfigSecurityCookie_ - imageBase_;
+    bool cookieInImage = loadConfigSecurityCookie_ >= imageBase_ &&
+                         cookieRva <= std::numeric_limits<std::uint32_t>::max() &&
+                         (is64Bit || loadConfigSecurityCookie_ <= 0xffffffff);
+
+    std::vector<impl::GSPattern> kinds;
+    std::vector<std::size_t> patternSizes;
+    std::vector<impl::BytePattern> patterns;
+    for (const auto& [kind, pattern] :
+         impl::gsPatterns(is64Bit, static_cast<std::uint32_t>(loadConfigSecurityCookie_))) {
+        kinds.push_back(kind);
+        patternSizes.push_back(pattern.size);
+        patterns.push_back(pattern);
+    }
+    impl::PatternScanner scanner(std::move(patterns));
+
+    struct Code {
+        std::uint32_t rva;
+        const std::uint8_t* data;
+        std::size_t size;
+    };
+    std::vector<Code> code;
+    peparse::IterSec(
+        loadedImage_.get(),
+        [](void* cbd, const peparse::VA&, const std::string&,
+           const peparse::image_section_header& section, const peparse::bounded_buffer* data) {
+            if ((section.Characteristics & peparse::IMAGE_SCN_MEM_EXECUTE) && data != nullptr) {
+                static_cast<std::vector<Code>*>(cbd)->push_back(
+                    {section.VirtualAddress, data->buf, data->bufLen});
+            }
+            return 0;
+        },
+        &code);
 
-        peparse::debug_dir_entry debugDir{};
-        uint32_t numberOfDebugDirs = debugDirectories.size() / sizeof(debugDir);
-        auto debugDirSize = std::min(debugDirectories.size(), sizeof(debugDir));
-
-        for (int i = 0; i < numberOfDebugDirs; i++) {
-            // copy the current debug directory into debugDir
-            memcpy(&debugDir, debugDirectories.data() + (i * debugDirSize), debugDirSize);
-            // 20 == IMAGE_DEBUG_TYPE_EX_DLLCHARACTERISTICS
-            // For now we only care about this debug directory since it contains the CETCOMPAT bit
-            if (debugDir.Type == 20) {
-                if (debugDir.PointerToRawData != 0) {
-                    auto dataPtr = debugDir.PointerToRawData + loadedImage_.get()->fileBuffer->buf;
-                    if ((dataPtr < loadedImage_.get()->fileBuffer->buf) ||
-                        (dataPtr > loadedImage_.get()->fileBuffer->buf +
-                                       loadedImage_.get()->fileBuffer->bufLen)) {
-                        std::cerr << "Warn: dataPtr is out of bounds"
-                                  << "\n";
-                        extendedDllCharacteristics_ = 0;
-                        return;
+    GSInstrumentation gs;
+    std::vector<std::uint32_t> cookieLoads;
+    std::vector<std::uint32_t> framePrologues;
+    std::vector<std::uint32_t> checkTargets;
+    std::vector<impl::PatternScanner::Match> matches;
+    for (const auto& section : code) {
+        ScopedDeadline::check();
+        matches.clear();
+        scanner.scan(section.data, section.size, matches);
+        for (const auto& match : matches) {
+            std::uint32_t rva = section.rva + static_cast<std::uint32_t>(match.offset);
+            switch (kinds[match.pattern]) {
+                case impl::kGSCookieLoad: {
+                    if (is64Bit) {
+                        auto disp = static_cast<std::int32_t>(
+                            impl::read32(section.data + match.offset + 3));
+                        if (static_cast<std::int64_t>(rva) + 7 + disp !=
+                            static_cast<std::int64_t>(cookieRva)) {
+                            break;
+                        }
                     }
-                    extendedDllCharacteristics_ = *((uint16_t*)dataPtr);
+                    [[fallthrough]];
+                }
+                case impl::kGSCookieLoadAbsolute: {
+                    if (cookieInImage) {
+                        cookieLoads.push_back(rva);
+                    }
+                    break;
+                }
+                case impl::kGSCookieCheck: {
+                    // The call's rel32 follows the pattern, relative to the end of the call.
+                    std::size_t end = match.offset + patternSizes[match.pattern] + 4;
+                    if (end <= section.size) {
+                        auto disp = static_cast<std::int32_t>(
+                            impl::read32(section.data + end - 4));
+                        checkTargets.push_back(static_cast<std::uint32_t>(
+                            section.rva + static_cast<std::uint32_t>(end) + disp));
+                    }
+                    break;
+                }
+                case impl::kGSFramePrologue: {
+                    framePrologues.push_back(rva);
+                    break;
+                }
+            }
+        }
+    }
+
+    // NOTE: Each cookie load is attributed to the function that contains it: on x86_64,
+    // the one whose unwind entry covers it; on x86_32, the one whose frame prologue last
+    // precedes it. Leaf functions without unwind entries (or frame pointers) aren't counted,
+    // but they have no frame to protect anyway.
+    constexpr auto kMaxRva = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> functions;
+    if (is64Bit) {
+        const auto& nt = loadedImage_.get()->peHeader.nt;
+        if (nt.OptionalHeader64.NumberOfRvaAndSizes > peparse::DIR_EXCEPTION) {
+            const auto& exceptions = nt.OptionalHeader64.DataDirectory[peparse::DIR_EXCEPTION];
+            std::uint64_t count = exceptions.Size / 12;
+            if (auto offset = loadedImage_.fileRange(exceptions.VirtualAddress, count * 12)) {
+                const std::uint8_t* entry = loadedImage_.get()->fileBuffer->buf + *offset;
+                for (std::uint64_t i = 0; i < count; ++i, entry += 12) {
+                    functions.emplace_back(impl::read32(entry), impl::read32(entry + 4));
                 }
             }
         }
     } else {
-        peparse::optional_header_32* optionalHeader = &(nt.OptionalHeader);
-        dllCharacteristics_ = optionalHeader->DllCharacteristics;
-        if (optionalHeader->NumberOfRvaAndSizes < peparse::DIR_COM_DESCRIPTOR + 1) {
-            std::cerr << "Warn: short image data directory vector (no CLR info?)"
-                      << "\n";
-            return;
+        for (auto rva : framePrologues) {
+            functions.emplace_back(rva, kMaxRva);
         }
-        clrConfig_ = optionalHeader->DataDirectory[peparse::DIR_COM_DESCRIPTOR];
-        // Warn and return early if the image data directory vector
-        // is too short to contain a reference to the DIR_LOAD_CONFIG.
-        if (optionalHeader->NumberOfRvaAndSizes < peparse::DIR_LOAD_CONFIG + 1) {
-            std::cerr << "Warn: short image data directory vector (no load config?)"
-                      << "\n";
-            return;
+    }
+    std::sort(functions.begin(), functions.end());
+
+    std::vector<bool> instrumented(functions.size());
+    for (auto rva : cookieLoads) {
+        auto next =
+            std::upper_bound(functions.begin(), functions.end(), std::make_pair(rva, kMaxRva));
+        if (next != functions.begin() && rva < std::prev(next)->second) {
+            instrumented[std::prev(next) - functions.begin()] = true;
         }
+    }
 
-        if (!peparse::GetDataDirectoryEntry(loadedImage_.get(), peparse::DIR_LOAD_CONFIG,
-                                            loadConfigData)) {
-            std::cerr << "Warn: No load config in the PE"
-                      << "\n";
-            return;
+    // NOTE: An un-keyed cookie can be passed to anything that takes a register argument, but
+    // every real check calls __security_check_cookie, so only calls to the target that most
+    // of the matches share are counted.
+    std::sort(checkTargets.begin(), checkTargets.end());
+    for (auto run = checkTargets.begin(); run != checkTargets.end();) {
+        auto next = std::upper_bound(run, checkTargets.end(), *run);
+        gs.checks = std::max(gs.checks, static_cast<std::uint32_t>(next - run));
+        run = next;
+    }
+
+    gs.functions = static_cast<std::uint32_t>(functions.size());
+    gs.instrumented = static_cast<std::uint32_t>(
+        std::count(instrumented.begin(), instrumented.end(), true));
+    gsInstrumentation_ = gs;
+    return gsInstrumentation_;
+}
+
+const std::vector<ImportFinding>& Checksec::riskyImports() const {
+    if (importsScanned_) {
+        return riskyImports_;
+    }
+    importsScanned_ = true;
+    if (loadedImage_.get() == nullptr) {
+        return riskyImports_;
+    }
+
+    impl::ScopedPhase phase(loadedImage_.timings(), Phase::Imports);
+    auto imports = loadedImage_.directory(peparse::DIR_IMPORT);
+    if (imports.VirtualAddress != 0) {
+        auto [data, size] = loadedImage_.sectionData(imports.VirtualAddress);
+        for (std::size_t i = 0; i + impl::kImportDescriptorSize <= size;
+             i += impl::kImportDescriptorSize) {
+            const std::uint8_t* descriptor = data + i;
+            std::uint32_t lookupTable = impl::read32(descriptor);
+            std::uint32_t name = impl::read32(descriptor + 12);
+            std::uint32_t addressTable = impl::read32(descriptor + 16);
+            if (name == 0 && addressTable == 0) {
+                break;
+            }
+            // NOTE: Some linkers leave out the lookup table, in which case the (unbound)
+            // address table has the same contents.
+            scanImportThunks(importName(name), lookupTable != 0 ? lookupTable : addressTable, 0,
+                             false);
         }
-        peparse::image_load_config_32 loadConfig{};
-        if (loadConfigData.size() > sizeof(loadConfig)) {
-            std::cerr << "Warn: large load config, probably contains undocumented "
-                         "fields"
-                      << "\n";
-        } else if (loadConfigData.size() < sizeof(loadConfig)) {
-            std::cerr << "Warn: undersized load config, probably missing fields"
-                      << "\n";
-        }
-        auto size = std::min(loadConfigData.size(), sizeof(loadConfig));
-        memcpy(&loadConfig, loadConfigData.data(), size);
-        loadConfigSize_ = loadConfigData.size();
-        loadConfigGuardFlags_ = loadConfig.GuardFlags;
-        loadConfigSecurityCookie_ = loadConfig.SecurityCookie;
-        loadConfigSEHandlerTable_ = loadConfig.SEHandlerTable;
-        loadConfigSEHandlerCount_ = loadConfig.SEHandlerCount;
-
-        if (!peparse::GetDataDirectoryEntry(loadedImage_.get(), peparse::DIR_DEBUG,
-                                            debugDirectories)) {
-            std::cerr << "Warn: No debug directories"
-                      << "\n";
-            return;
+    }
+
+    auto delayImports = loadedImage_.directory(peparse::DIR_DELAY_IMPORT);
+    if (delayImports.VirtualAddress != 0) {
+        auto [data, size] = loadedImage_.sectionData(delayImports.VirtualAddress);
+        for (std::size_t i = 0; i + impl::kDelayImportDescriptorSize <= size;
+             i += impl::kDelayImportDescriptorSize) {
+            const std::uint8_t* descriptor = data + i;
+            std::uint32_t attributes = impl::read32(descriptor);
+            std::uint32_t name = impl::read32(descriptor + 4);
+            std::uint32_t nameTable = impl::read32(descriptor + 16);
+            if (name == 0) {
+                break;
+            }
+
+            // NOTE: Descriptors from before the RvaBased attribute hold VAs instead.
+            std::uint64_t base = (attributes & impl::kDelayImportRvaBased) ? 0 : imageBase_;
+            if (name < base || nameTable < base) {
+                continue;
+            }
+            scanImportThunks(importName(static_cast<std::uint32_t>(name - base)),
+                             static_cast<std::uint32_t>(nameTable - base), base, true);
         }
+    }
 
-        peparse::debug_dir_entry debugDir{};
-        auto numberOfDebugDirs = debugDirectories.size() / sizeof(debugDir);
-        auto debugDirSize = std::min(debugDirectories.size(), sizeof(debugDir));
-
-        for (int i = 0; i < numberOfDebugDirs; i++) {
-            memcpy(&debugDir, debugDirectories.data() + (i * debugDirSize), debugDirSize);
-            if (debugDir.Type == 20) {
-                if (debugDir.PointerToRawData != 0) {
-                    auto dataPtr = debugDir.PointerToRawData + loadedImage_.get()->fileBuffer->buf;
-                    if ((dataPtr < loadedImage_.get()->fileBuffer->buf) ||
-                        (dataPtr > loadedImage_.get()->fileBuffer->buf +
-                                       loadedImage_.get()->fileBuffer->bufLen)) {
-                        std::cerr << "Warn: dataPtr is out of bounds"
-                                  << "\n";
-                        extendedDllCharacteristics_ = 0;
-                        return;
-                    }
-                    extendedDllCharacteristics_ = *((uint16_t*)dataPtr);
+    return riskyImports_;
+}
+
+void Checksec::scanImportThunks(std::string_view module, std::uint32_t thunks,
+                                std::uint64_t base, bool delayLoaded) const {
+    std::size_t pointerSize = is64Bit_ ? 8 : 4;
+    std::uint64_t ordinalFlag = std::uint64_t{1} << (pointerSize * 8 - 1);
+    auto [data, size] = loadedImage_.sectionData(thunks);
+    for (std::size_t i = 0; i + pointerSize <= size; i += pointerSize) {
+        std::uint64_t thunk = is64Bit_ ? impl::read64(data + i) : impl::read32(data + i);
+        if (thunk == 0) {
+            break;
+        }
+        // Imports by ordinal have no name to match.
+        if ((thunk & ordinalFlag) || thunk < base ||
+            thunk - base > std::numeric_limits<std::uint32_t>::max() - 2) {
+            continue;
+        }
+
+        // NOTE: Each name is an IMAGE_IMPORT_BY_NAME: a two-byte hint, then the name.
+        // Names are matched in place, and only the (few) matches are copied out.
+        auto name = importName(static_cast<std::uint32_t>(thunk - base) + 2);
+        if (const auto* api = impl::findRiskyApi(name)) {
+            riskyImports_.push_back({std::string(module), api->name, api->risk, delayLoaded});
+        }
+    }
+}
+
+std::string_view Checksec::importName(std::uint32_t rva) const {
+    auto [data, size] = loadedImage_.sectionData(rva);
+    const void* end = data ? std::memchr(data, '\0', size) : nullptr;
+    if (end == nullptr) {
+        return {};
+    }
+    return std::string_view(reinterpret_cast<const char*>(data),
+                            static_cast<const std::uint8_t*>(end) - data);
+}
+
+void Checksec::parseDebugDirectories() {
+    std::vector<std::uint8_t> debugDirectories;
+    loadedImage_.fetchDirectory(peparse::DIR_DEBUG);
+    if (!peparse::GetDataDirectoryEntry(loadedImage_.get(), peparse::DIR_DEBUG,
+                                        debugDirectories)) {
+        std::cerr << "Warn: No debug directories"
+                  << "\n";
+        return;
+    }
+
+    peparse::debug_dir_entry debugDir{};
+    auto numberOfDebugDirs = debugDirectories.size() / sizeof(debugDir);
+    auto debugDirSize = std::min(debugDirectories.size(), sizeof(debugDir));
+
+    for (std::size_t i = 0; i < numberOfDebugDirs; i++) {
+        // copy the current debug directory into debugDir
+        memcpy(&debugDir, debugDirectories.data() + (i * debugDirSize), debugDirSize);
+        // 20 == IMAGE_DEBUG_TYPE_EX_DLLCHARACTERISTICS
+        // For now we only care about this debug directory since it contains the CETCOMPAT bit
+        if (debugDir.Type == 20) {
+            if (debugDir.PointerToRawData != 0) {
+                loadedImage_.fetch(debugDir.PointerToRawData, sizeof(std::uint16_t));
+                auto dataPtr = debugDir.PointerToRawData + loadedImage_.get()->fileBuffer->buf;
+                if ((dataPtr < loadedImage_.get()->fileBuffer->buf) ||
+                    (dataPtr > loadedImage_.get()->fileBuffer->buf +
+                                   loadedImage_.get()->fileBuffer->bufLen)) {
+                    std::cerr << "Warn: dataPtr is out of bounds"
+                              << "\n";
+                    extendedDllCharacteristics_ = 0;
+                    return;
                 }
+                extendedDllCharacteristics_ = *((uint16_t*)dataPtr);
             }
         }
     }
 }
 
-const MitigationReport Checksec::isDynamicBase() const {
+void Checksec::evaluate() {
+    auto present = [this](Mitigation mitigation) {
+        return summary_.presence(mitigation) == MitigationPresence::Present;
+    };
+
     if (dllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE) {
-        return REPORT(Present, kDynamicBaseDescription);
+        SET(DynamicBase, Present);
     } else {
-        return REPORT(NotPresent, kDynamicBaseDescription);
+        SET(DynamicBase, NotPresent);
+    }
+
+    if (clrConfig_.VirtualAddress != 0) {
+        SET(DotNET, Present);
+    } else {
+        SET(DotNET, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isASLR() const {
     // A binary is ASLR'd if:
     // * It was linked with /DYNAMICBASE and has *not* had its relocation
     // entries stripped, or
     // * It's managed by the CLR, which is always ASLR'd.
-    if (isDynamicBase()) {
+    if (present(Mitigation::DynamicBase)) {
         if (imageCharacteristics_ & peparse::IMAGE_FILE_RELOCS_STRIPPED) {
-            return REPORT_EXPLAIN(NotPresent, kASLRDescription,
-                                  "Image has stripped relocations, making ASLR impossible.");
+            SET_EXPLAIN(ASLR, NotPresent, kStrippedRelocationsExplanation);
+        } else {
+            SET(ASLR, Present);
         }
-        return REPORT(Present, kASLRDescription);
-    } else if (isDotNET()) {
-        return REPORT_EXPLAIN(Present, kASLRDescription,
-                              ".NET binaries have ASLR via the .NET runtime.");
+    } else if (present(Mitigation::DotNET)) {
+        SET_EXPLAIN(ASLR, Present, kDotNETASLRExplanation);
     } else {
-        return REPORT(NotPresent, kASLRDescription);
+        SET(ASLR, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isHighEntropyVA() const {
     // NOTE(ww): Set by /HIGHENTROPYVA, but not exposed anywhere as a constant.
     // Only relevant on 64-bit machines with 64-bit images.
     // NOTE(ww): Additionally, don't count a binary as high-entropy capable
     // if it isn't also ASLR'd.
-    if ((dllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_HIGH_ENTROPY_VA) && isASLR()) {
-        return REPORT(Present, kHighEntropyVADescription);
+    if ((dllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_HIGH_ENTROPY_VA) &&
+        present(Mitigation::ASLR)) {
+        SET(HighEntropyVA, Present);
     } else {
-        return REPORT(NotPresent, kHighEntropyVADescription);
+        SET(HighEntropyVA, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isForceIntegrity() const {
     if (dllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_FORCE_INTEGRITY) {
-        return REPORT(Present, kForceIntegrityDescription);
+        SET(ForceIntegrity, Present);
     } else {
-        return REPORT(NotPresent, kForceIntegrityDescription);
+        SET(ForceIntegrity, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isNX() const {
     if ((dllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_NX_COMPAT)) {
-        return REPORT(Present, kNXDescription);
-    } else if (isDotNET()) {
-        return REPORT_EXPLAIN(Present, kNXDescription,
-                              ".NET binaries have DEP via the .NET runtime.");
+        SET(NX, Present);
+    } else if (present(Mitigation::DotNET)) {
+        SET_EXPLAIN(NX, Present, kDotNETNXExplanation);
     } else {
-        return REPORT(NotPresent, kNXDescription);
+        SET(NX, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isIsolation() const {
     if (!(dllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_NO_ISOLATION)) {
-        return REPORT(Present, kIsolationDescription);
+        SET(Isolation, Present);
     } else {
-        return REPORT(NotPresent, kIsolationDescription);
+        SET(Isolation, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isSEH() const {
     if (!(dllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_NO_SEH)) {
-        return REPORT(Present, kSEHDescription);
+        SET(SEH, Present);
     } else {
-        return REPORT(NotPresent, kSEHDescription);
+        SET(SEH, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isCFG() const {
     // NOTE(ww): See the /GUARD:CF docs: /DYNAMICBASE is required.
     // We check for ASLR instead, since just checking for /DYNAMICBASE
     // could result in a false-positive (with stripped relocations).
-    if (!isASLR()) {
-        return REPORT_EXPLAIN(NotPresent, kCFGDescription,
-                              "Control Flow Guard requires functional ASLR.");
-    }
-
-    if (dllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_GUARD_CF) {
-        return REPORT(Present, kCFGDescription);
-    } else {
-        return REPORT(NotPresent, kCFGDescription);
-    }
-}
-
-const MitigationReport Checksec::isAuthenticode() const {
-    if (uthenticode::verify(loadedImage_.get())) {
-        return REPORT(Present, kAuthenticodeDescription);
+    if (!present(Mitigation::ASLR)) {
+        SET_EXPLAIN(CFG, NotPresent, kCFGRequiresASLRExplanation);
+    } else if (dllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_GUARD_CF) {
+        SET(CFG, Present);
     } else {
-        return REPORT(NotPresent, kAuthenticodeDescription);
+        SET(CFG, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isRFG() const {
     // NOTE(ww): a load config under 92/148 bytes implies the absence of the
     // GuardFlags field. See:
     // https://docs.microsoft.com/en-us/windows/win32/debug/pe-format#load-configuration-layout
     if (loadConfigSize_ < 148 &&
         !(imageCharacteristics_ & peparse::IMAGE_FILE_32BIT_MACHINE && loadConfigSize_ >= 92)) {
-        return REPORT_EXPLAIN(NotPresent, kRFGDescription,
-                              "Image load config is too short to contain RFG "
-                              "configuration fields.");
+        SET_EXPLAIN(RFG, NotPresent, kShortLoadConfigRFGExplanation);
+    } else if ((loadConfigGuardFlags_ & 0x00020000) &&
+               (loadConfigGuardFlags_ & 0x00040000 || loadConfigGuardFlags_ & 0x00080000)) {
+        // https://xlab.tencent.com/en/2016/11/02/return-flow-guard/
+        SET(RFG, Present);
+    } else {
+        SET(RFG, NotPresent);
     }
 
-    // https://xlab.tencent.com/en/2016/11/02/return-flow-guard/
-    if ((loadConfigGuardFlags_ & 0x00020000) &&
-        (loadConfigGuardFlags_ & 0x00040000 || loadConfigGuardFlags_ & 0x00080000)) {
-        return REPORT(Present, kRFGDescription);
+    if (targetMachine_ != peparse::IMAGE_FILE_MACHINE_I386) {
+        SET_EXPLAIN(SafeSEH, NotApplicable, kSafeSEHNotApplicableExplanation);
+    } else if (loadConfigSize_ < 112 &&
+               !(imageCharacteristics_ & peparse::IMAGE_FILE_32BIT_MACHINE &&
+                 loadConfigSize_ >= 72)) {
+        // NOTE(ww): a load config under 72/112 bytes implies the absence of the
+        // SafeSEH fields.
+        SET_EXPLAIN(SafeSEH, NotPresent, kShortLoadConfigSafeSEHExplanation);
+    } else if (present(Mitigation::SEH) && loadConfigSEHandlerTable_ != 0 &&
+               loadConfigSEHandlerCount_ != 0) {
+        SET(SafeSEH, Present);
     } else {
-        return REPORT(NotPresent, kRFGDescription);
+        SET(SafeSEH, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isSafeSEH() const {
-    if (targetMachine_ != peparse::IMAGE_FILE_MACHINE_I386) {
-        return REPORT_EXPLAIN(NotApplicable, kSafeSEHDescription,
-                              "The SafeSEH mitigation only applies to x86_32 binaries.");
+    // NOTE(ww): a load config under 64/96 bytes implies the absence of the
+    // SecurityCookie field.
+    if (loadConfigSize_ < 96 &&
+        !(imageCharacteristics_ & peparse::IMAGE_FILE_32BIT_MACHINE && loadConfigSize_ >= 64)) {
+        SET_EXPLAIN(GS, NotPresent, kShortLoadConfigGSExplanation);
+    } else if (loadConfigSecurityCookie_ != 0) {
+        SET(GS, Present);
+    } else {
+        SET(GS, NotPresent);
+    }
+
+    if (extendedDllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_EX_CET_COMPAT) {
+        SET(CetCompat, Present);
+    } else {
+        SET(CetCompat, NotPresent);
     }
 
-    // NOTE(ww): a load config under 72/112 bytes implies the absence of the
-    // SafeSEH fields.
-    if (loadConfigSize_ < 112 &&
-        !(imageCharacteristics_ & peparse::IMAGE_FILE_32BIT_MACHINE && loadConfigSize_ >= 72)) {
-        return REPORT_EXPLAIN(NotPresent, kSafeSEHDescription,
-                              "Image load config is too short to contain a SE handler table.");
+    // NOTE: The DllCharacteristics bit only says that the image was linked with /guard:cf;
+    // CFG has nothing to enforce unless the compiler actually instrumented it, and listed its
+    // call targets.
+    const auto& layout = is64Bit_ ? impl::kLoadConfigLayout64 : impl::kLoadConfigLayout32;
+    if (!present(Mitigation::CFG)) {
+        SET_EXPLAIN(CFGTable, NotPresent, kCFGTableRequiresCFGExplanation);
+    } else if (loadConfigSize_ < layout.guardCFFunctionTableSize) {
+        SET_EXPLAIN(CFGTable, NotPresent, kShortLoadConfigCFGTableExplanation);
+    } else if (!(loadConfigGuardFlags_ & impl::kGuardCFInstrumented) ||
+               !(loadConfigGuardFlags_ & impl::kGuardCFFunctionTablePresent) ||
+               loadConfigGuardCFFunctionCount_ == 0) {
+        SET(CFGTable, NotPresent);
+    } else if (!guardCFFunctionTableOffset_) {
+        SET_EXPLAIN(CFGTable, NotPresent, kCFGTableOutOfBoundsExplanation);
+    } else {
+        SET(CFGTable, Present);
     }
 
-    if (isSEH() && loadConfigSEHandlerTable_ != 0 && loadConfigSEHandlerCount_ != 0) {
-        return REPORT(Present, kSafeSEHDescription);
+    if (!present(Mitigation::CFG)) {
+        SET_EXPLAIN(XFG, NotPresent, kXFGRequiresCFGExplanation);
+    } else if (loadConfigSize_ < layout.guardXFGCheckFunctionPointer + layout.pointerSize) {
+        SET_EXPLAIN(XFG, NotPresent, kShortLoadConfigXFGExplanation);
+    } else if ((loadConfigGuardFlags_ & impl::kGuardXFGEnabled) &&
+               loadConfigGuardXFGCheckFunctionPointer_ != 0) {
+        SET(XFG, Present);
     } else {
-        return REPORT(NotPresent, kSafeSEHDescription);
+        SET(XFG, NotPresent);
     }
-}
 
-const MitigationReport Checksec::isGS() const {
-    // NOTE(ww): a load config under 64/96 bytes implies the absence of the
-    // SecurityCookie field.
-    if (loadConfigSize_ < 96 &&
-        !(imageCharacteristics_ & peparse::IMAGE_FILE_32BIT_MACHINE && loadConfigSize_ >= 64)) {
-        return REPORT_EXPLAIN(NotPresent, kGSDescription,
-                              "Image load config is too short to contain a GS security cookie.");
+    // NOTE: /guard:ehcont is only supported for x64 (and ARM64) images.
+    if (!is64Bit_) {
+        SET_EXPLAIN(EHContinuation, NotApplicable, kEHContinuationNotApplicableExplanation);
+    } else if (loadConfigSize_ < layout.guardEHContinuationCount + layout.pointerSize) {
+        SET_EXPLAIN(EHContinuation, NotPresent, kShortLoadConfigEHContinuationExplanation);
+    } else if (!(loadConfigGuardFlags_ & impl::kGuardEHContinuationTablePresent) ||
+               loadConfigGuardEHContinuationCount_ == 0) {
+        SET(EHContinuation, NotPresent);
+    } else if (!guardEHContinuationTableOffset_) {
+        SET_EXPLAIN(EHContinuation, NotPresent, kEHContinuationOutOfBoundsExplanation);
+    } else {
+        SET(EHContinuation, Present);
     }
 
-    if (loadConfigSecurityCookie_ != 0) {
-        return REPORT(Present, kGSDescription);
+    if (!present(Mitigation::CetCompat)) {
+        SET_EXPLAIN(CetStrict, NotPresent, kCetStrictRequiresCetExplanation);
+    } else if (extendedDllCharacteristics_ & impl::kDllCharacteristicsExCetCompatStrictMode) {
+        SET(CetStrict, Present);
     } else {
-        return REPORT(NotPresent, kGSDescription);
+        SET(CetStrict, NotPresent);
+    }
+
+    // NOTE: Authenticode is the one expensive check, so it's left as NotImplemented
+    // until it's asked for; see verifyAuthenticode.
+
+    // NOTE: Unselected checks are still evaluated above when they're cheap (some selected
+    // checks depend on them), but they're only reported as NotImplemented.
+    for (std::size_t i = 0; i < kMitigationCount; ++i) {
+        auto mitigation = static_cast<Mitigation>(i);
+        if (!(checks_ & checkMask(mitigation))) {
+            summary_.set(mitigation, MitigationPresence::NotImplemented);
+        }
     }
 }
 
-const MitigationReport Checksec::isDotNET() const {
-    if (clrConfig_.VirtualAddress != 0) {
-        return REPORT(Present, kDotNETDescription);
-    } else {
-        return REPORT(NotPresent, kDotNETDescription);
+const MitigationSummary& Checksec::summary() const {
+    verifyAuthenticode();
+    return summary_;
+}
+
+const MitigationReport Checksec::report(Mitigation mitigation) const {
+    if (mitigation == Mitigation::Authenticode) {
+        verifyAuthenticode();
     }
+
+    return {
+        summary_.presence(mitigation),
+        description(mitigation),
+        summary_.explanation(mitigation),
+    };
 }
 
-const MitigationReport Checksec::isCetCompat() const {
-    if (extendedDllCharacteristics_ & peparse::IMAGE_DLLCHARACTERISTICS_EX_CET_COMPAT) {
-        return REPORT(Present, kCetDescription);
-    } else {
-        return REPORT(NotPresent, kCetDescription);
+const MitigationReport Checksec::isDynamicBase() const { return report(Mitigation::DynamicBase); }
+
+const MitigationReport Checksec::isASLR() const { return report(Mitigation::ASLR); }
+
+const MitigationReport Checksec::isHighEntropyVA() const {
+    return report(Mitigation::HighEntropyVA);
+}
+
+const MitigationReport Checksec::isForceIntegrity() const {
+    return report(Mitigation::ForceIntegrity);
+}
+
+const MitigationReport Checksec::isNX() const { return report(Mitigation::NX); }
+
+const MitigationReport Checksec::isIsolation() const { return report(Mitigation::Isolation); }
+
+const MitigationReport Checksec::isSEH() const { return report(Mitigation::SEH); }
+
+const MitigationReport Checksec::isCFG() const { return report(Mitigation::CFG); }
+
+const MitigationReport Checksec::isAuthenticode() const { return report(Mitigation::Authenticode); }
+
+const std::optional<AuthenticodeDigest>& Checksec::authenticodeDigest() const {
+    verifyAuthenticode();
+    return authenticodeDigest_;
+}
+
+DetachedResult Checksec::detach() {
+    DetachedResult result;
+    result.summary = summary();
+    result.targetMachine = targetMachine_;
+    result.is64Bit = is64Bit_;
+    if (authenticodeDigest_) {
+        authenticodeDigest_->algorithm.copy(result.digestAlgorithm,
+                                            sizeof(result.digestAlgorithm) - 1);
+        authenticodeDigest_->digest.copy(result.digest, sizeof(result.digest) - 1);
+    }
+
+    loadedImage_.release();
+    result.timings = loadedImage_.timings();
+    return result;
+}
+
+void Checksec::verifyAuthenticode() const {
+    if (authenticodeVerified_) {
+        return;
+    }
+    authenticodeVerified_ = true;
+    if (!(checks_ & checkMask(Mitigation::Authenticode))) {
+        return;
+    }
+
+    // NOTE: An image without a security directory can't carry a signature, so there's
+    // no need to read (and hash) the rest of a partially loaded image to find that out.
+    summary_.set(Mitigation::Authenticode, MitigationPresence::NotPresent);
+    if (securityDir_.VirtualAddress == 0 || securityDir_.Size == 0) {
+        return;
+    }
+
+    // NOTE: This is uthenticode::verify, unrolled so that we can hold on to the
+    // digest that we've already paid to compute.
+    impl::ScopedPhase phase(loadedImage_.timings(), Phase::Authenticode);
+    loadedImage_.loadFull();
+    const auto certs = uthenticode::read_certs(loadedImage_.get());
+    if (certs.empty()) {
+        return;
+    }
+
+    std::optional<AuthenticodeDigest> digest;
+    for (const auto& cert : certs) {
+        ScopedDeadline::check();
+        const auto signedData = cert.as_signed_data();
+        if (!signedData || !signedData->verify_signature()) {
+            return;
+        }
+
+        const auto [kind, embedded] = signedData->get_checksum();
+        if (embedded != uthenticode::calculate_checksum(loadedImage_.get(), kind)) {
+            return;
+        }
+
+        if (digest) {
+            continue;
+        }
+        switch (kind) {
+            case uthenticode::checksum_kind::MD5: {
+                digest = AuthenticodeDigest{"MD5", embedded};
+                break;
+            }
+            case uthenticode::checksum_kind::SHA1: {
+                digest = AuthenticodeDigest{"SHA1", embedded};
+                break;
+            }
+            case uthenticode::checksum_kind::SHA256: {
+                digest = AuthenticodeDigest{"SHA256", embedded};
+                break;
+            }
+            default: {
+                digest = AuthenticodeDigest{"Unknown", embedded};
+                break;
+            }
+        }
     }
+
+    summary_.set(Mitigation::Authenticode, MitigationPresence::Present);
+    authenticodeDigest_ = std::move(digest);
 }
 
+const MitigationReport Checksec::isRFG() const { return report(Mitigation::RFG); }
+
+const MitigationReport Checksec::isSafeSEH() const { return report(Mitigation::SafeSEH); }
+
+const MitigationReport Checksec::isGS() const { return report(Mitigation::GS); }
+
+const MitigationReport Checksec::isDotNET() const { return report(Mitigation::DotNET); }
+
+const MitigationReport Checksec::isCetCompat() const { return report(Mitigation::CetCompat); }
+
+const MitigationReport Checksec::isCFGTable() const { return report(Mitigation::CFGTable); }
+
+const MitigationReport Checksec::isXFG() const { return report(Mitigation::XFG); }
+
+const MitigationReport Checksec::isEHContinuation() const {
+    return report(Mitigation::EHContinuation);
+}
+
+const MitigationReport Checksec::isCetStrict() const { return report(Mitigation::CetStrict); }
+
 }  // namespace checksec
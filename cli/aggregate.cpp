@@ -0,0 +1,200 @@
+#include "aggregate.h"
+
+#include <atomic>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+#include "render.h"
+
+namespace checksec::cli {
+
+namespace {
+constexpr MitigationPresence kPresences[] = {
+    MitigationPresence::Present,
+    MitigationPresence::NotPresent,
+    MitigationPresence::NotApplicable,
+    MitigationPresence::NotImplemented,
+};
+
+std::atomic<std::uint64_t> nextId{1};
+
+std::string machineName(std::uint16_t machine) {
+    switch (machine) {
+        case 0x014c:
+            return "I386";
+        case 0x0200:
+            return "IA64";
+        case 0x8664:
+            return "AMD64";
+        case 0x01c0:
+            return "ARM";
+        case 0x01c4:
+            return "ARMNT";
+        case 0xaa64:
+            return "ARM64";
+        default: {
+            std::ostringstream os;
+            os << "0x" << std::hex << std::setw(4) << std::setfill('0') << machine;
+            return os.str();
+        }
+    }
+}
+
+bool isSeparator(char c) { return c == '/' || c == '\\'; }
+}  // namespace
+
+Aggregate::Tally& Aggregate::Tally::operator+=(const Tally& other) {
+    files += other.files;
+    for (std::size_t i = 0; i < kMitigationCount; ++i) {
+        for (std::size_t j = 0; j < std::size(kPresences); ++j) {
+            counts[i][j] += other.counts[i][j];
+        }
+    }
+    return *this;
+}
+
+Aggregate::Aggregate(std::size_t groupDepth) : groupDepth_(groupDepth), id_(nextId++) {}
+
+std::string_view Aggregate::group(std::string_view path) const {
+    if (groupDepth_ == 0) {
+        return {};
+    }
+
+    // NOTE: Files with fewer leading directories than the group depth are grouped under
+    // their own directory, or "." when they don't have one.
+    std::size_t directories = 0;
+    std::size_t end = std::string_view::npos;
+    for (std::size_t i = 0; i < path.size(); ++i) {
+        if (isSeparator(path[i]) && i > 0 && !isSeparator(path[i - 1])) {
+            end = i;
+            if (++directories == groupDepth_) {
+                break;
+            }
+        }
+    }
+    return end == std::string_view::npos ? std::string_view(".") : path.substr(0, end);
+}
+
+Aggregate::Tallies& Aggregate::shard() {
+    thread_local struct {
+        std::uint64_t id = 0;
+        Tallies* tallies = nullptr;
+    } cached;
+
+    if (cached.id != id_) {
+        std::lock_guard<std::mutex> lock(shardsMutex_);
+        shards_.push_back(std::make_unique<Tallies>());
+        cached.id = id_;
+        cached.tallies = shards_.back().get();
+    }
+    return *cached.tallies;
+}
+
+void Aggregate::record(std::string_view path, const ScanResult& result) {
+    auto& tallies = shard();
+    auto key = std::make_tuple(group(path), result.targetMachine, result.is64Bit);
+    auto tally = tallies.find(key);
+    if (tally == tallies.end()) {
+        tally = tallies.emplace(Key(std::string(std::get<0>(key)), std::get<1>(key),
+                                    std::get<2>(key)),
+                                Tally{})
+                    .first;
+    }
+
+    ++tally->second.files;
+    for (std::size_t i = 0; i < kMitigationCount; ++i) {
+        auto presence = result.summary.presence(static_cast<Mitigation>(i));
+        ++tally->second.counts[i][static_cast<std::size_t>(presence)];
+    }
+}
+
+Aggregate::Tallies Aggregate::merged() const {
+    std::lock_guard<std::mutex> lock(shardsMutex_);
+    Tallies merged;
+    for (const auto& shard : shards_) {
+        for (const auto& [key, tally] : *shard) {
+            merged[key] += tally;
+        }
+    }
+    return merged;
+}
+
+void Aggregate::print(std::ostream& os) const {
+    auto tallies = merged();
+
+    Tally total;
+    for (const auto& [key, tally] : tallies) {
+        total += tally;
+    }
+
+    auto table = [&os](const Tally& tally) {
+        os << "  " << std::string(16, ' ');
+        for (auto presence : kPresences) {
+            os << std::setw(16) << presenceName(presence);
+        }
+        os << "\n";
+        for (const auto& field : kMitigationFields) {
+            os << "  " << field.label;
+            for (auto count : tally.counts[static_cast<std::size_t>(field.mitigation)]) {
+                os << std::setw(16) << count;
+            }
+            os << "\n";
+        }
+    };
+
+    for (const auto& [key, tally] : tallies) {
+        const auto& [group, machine, is64Bit] = key;
+        os << "Results for: ";
+        if (groupDepth_ != 0) {
+            os << group << ", ";
+        }
+        os << machineName(machine) << " (" << (is64Bit ? "64" : "32") << "-bit), " << tally.files
+           << " files\n";
+        table(tally);
+        os << "\n";
+    }
+
+    os << "Results for: all " << total.files << " files\n";
+    table(total);
+}
+
+nlohmann::json Aggregate::toJson() const {
+    auto counts = [](const Counts& counts) {
+        auto mitigations = nlohmann::json::object();
+        for (const auto& field : kMitigationFields) {
+            auto& mitigation = mitigations[std::string(field.key)];
+            for (auto presence : kPresences) {
+                mitigation[std::string(presenceName(presence))] =
+                    counts[static_cast<std::size_t>(field.mitigation)]
+                          [static_cast<std::size_t>(presence)];
+            }
+        }
+        return mitigations;
+    };
+
+    auto groups = nlohmann::json::array();
+    Tally total;
+    for (const auto& [key, tally] : merged()) {
+        const auto& [group, machine, is64Bit] = key;
+        nlohmann::json j = {
+            {"machine", machineName(machine)},
+            {"bits", is64Bit ? 64 : 32},
+            {"files", tally.files},
+            {"mitigations", counts(tally.counts)},
+        };
+        if (groupDepth_ != 0) {
+            j["group"] = group;
+        }
+        groups.push_back(std::move(j));
+        total += tally;
+    }
+
+    return {
+        {"files", total.files},
+        {"mitigations", counts(total.counts)},
+        {"groups", groups},
+    };
+}
+
+}  // namespace checksec::cli
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "result.h"
+#include "vendor/json.hpp"
+
+namespace checksec::cli {
+
+/**
+ * Corpus-wide counts of each mitigation's presence, in place of per-file results.
+ *
+ * Counts are broken down by machine type and by 32- vs 64-bit, and optionally by each file's
+ * leading directories. Each worker thread counts into its own shard, without any
+ * synchronization; shards are only merged when the totals are printed, so memory stays
+ * constant regardless of how many files are scanned.
+ */
+class Aggregate {
+   public:
+    /**
+     * @param groupDepth the number of leading directories to group files by, or 0 to not group
+     *  files by directory
+     */
+    explicit Aggregate(std::size_t groupDepth = 0);
+
+    /**
+     * Counts the result for the file at `path`.
+     *
+     * @note Safe to call from multiple threads at once.
+     */
+    void record(std::string_view path, const ScanResult& result);
+
+    /**
+     * Prints a table of counts for each group, machine and bitness.
+     *
+     * @note Must not be called while results are still being recorded.
+     */
+    void print(std::ostream& os) const;
+
+    /**
+     * @note Must not be called while results are still being recorded.
+     */
+    nlohmann::json toJson() const;
+
+    /**
+     * @return the directory prefix that `path` is grouped under
+     */
+    std::string_view group(std::string_view path) const;
+
+   private:
+    using Counts = std::array<std::array<std::uint64_t, 4>, kMitigationCount>;
+
+    // (group, machine, 64-bit)
+    using Key = std::tuple<std::string, std::uint16_t, bool>;
+
+    struct Tally {
+        std::uint64_t files = 0;
+        Counts counts{};
+
+        Tally& operator+=(const Tally& other);
+    };
+
+    // NOTE: Ordered with a transparent comparator, so that tallies can be found without
+    // copying the group.
+    using Tallies = std::map<Key, Tally, std::less<>>;
+
+    Tallies& shard();
+    Tallies merged() const;
+
+    std::size_t groupDepth_;
+
+    // Identifies this aggregate to each thread's cached shard, which (unlike an address) is
+    // never reused.
+    std::uint64_t id_;
+
+    mutable std::mutex shardsMutex_;
+    std::vector<std::unique_ptr<Tallies>> shards_;
+};
+
+}  // namespace checksec::cli
@@ -0,0 +1,101 @@
+#include "budget.h"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+namespace checksec::cli {
+
+void ByteBudget::Reservation::release() {
+    if (budget_ == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(budget_->mutex_);
+        budget_->inFlight_ -= bytes_;
+    }
+    budget_->released_.notify_all();
+    budget_ = nullptr;
+}
+
+ByteBudget::Reservation ByteBudget::reserve(std::uint64_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [&] { return inFlight_ == 0 || inFlight_ + bytes <= limit_; });
+    inFlight_ += bytes;
+    peak_ = std::max(peak_, inFlight_);
+    return Reservation(this, bytes);
+}
+
+std::uint64_t ByteBudget::peak() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return peak_;
+}
+
+std::optional<std::uint64_t> parseByteSize(std::string_view text) {
+    std::uint64_t value = 0;
+    std::size_t i = 0;
+    for (; i < text.size() && std::isdigit(static_cast<unsigned char>(text[i])); ++i) {
+        if (value > (std::numeric_limits<std::uint64_t>::max() - 9) / 10) {
+            return std::nullopt;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    if (i == 0 || text.size() - i > 1) {
+        return std::nullopt;
+    }
+
+    unsigned shift = 0;
+    if (i < text.size()) {
+        switch (std::toupper(static_cast<unsigned char>(text[i]))) {
+            case 'K': {
+                shift = 10;
+                break;
+            }
+            case 'M': {
+                shift = 20;
+                break;
+            }
+            case 'G': {
+                shift = 30;
+                break;
+            }
+            default: {
+                return std::nullopt;
+            }
+        }
+    }
+    if (value > (std::numeric_limits<std::uint64_t>::max() >> shift)) {
+        return std::nullopt;
+    }
+    return value << shift;
+}
+
+std::optional<std::chrono::milliseconds> parseDuration(std::string_view text) {
+    std::size_t digits = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) {
+        ++digits;
+    }
+    auto unit = text.substr(digits);
+
+    std::uint64_t scale;
+    if (unit == "ms") {
+        scale = 1;
+    } else if (unit.empty() || unit == "s") {
+        scale = 1000;
+    } else if (unit == "m") {
+        scale = 60 * 1000;
+    } else {
+        return std::nullopt;
+    }
+
+    // Without a suffix, a byte size is just a (range-checked) number.
+    auto value = parseByteSize(text.substr(0, digits));
+    if (!value || *value > static_cast<std::uint64_t>(std::chrono::milliseconds::max().count()) /
+                               scale) {
+        return std::nullopt;
+    }
+    return std::chrono::milliseconds(*value * scale);
+}
+
+}  // namespace checksec::cli
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+namespace checksec::cli {
+
+/**
+ * A global budget of bytes held in memory by in-flight scans. Reserving bytes blocks while the
+ * budget is spent, which keeps workers from loading more images than fit.
+ *
+ * A reservation larger than the whole budget is still granted, but only once nothing else is in
+ * flight, so that one oversized file can't stall the scan forever.
+ */
+class ByteBudget {
+   public:
+    /**
+     * Bytes reserved from a budget, which are returned to it when the reservation is released
+     * or destroyed.
+     */
+    class Reservation {
+       public:
+        Reservation(Reservation&& other) noexcept
+            : budget_(other.budget_), bytes_(other.bytes_) {
+            other.budget_ = nullptr;
+        }
+        ~Reservation() { release(); }
+
+        // can't make copies of Reservation
+        Reservation(const Reservation&) = delete;
+        Reservation& operator=(const Reservation&) = delete;
+        Reservation& operator=(Reservation&&) = delete;
+
+        /**
+         * Returns the reserved bytes to the budget. Does nothing if they've already been
+         * returned.
+         */
+        void release();
+
+       private:
+        friend class ByteBudget;
+
+        Reservation(ByteBudget* budget, std::uint64_t bytes) : budget_(budget), bytes_(bytes) {}
+
+        ByteBudget* budget_;
+        std::uint64_t bytes_;
+    };
+
+    explicit ByteBudget(std::uint64_t limit) : limit_(limit) {}
+
+    /**
+     * Reserves `bytes` from the budget, waiting until enough of it is free.
+     *
+     * @note Safe to call from multiple threads at once.
+     */
+    Reservation reserve(std::uint64_t bytes);
+
+    /**
+     * @return the most bytes that have been reserved at once
+     */
+    std::uint64_t peak() const;
+
+   private:
+    std::uint64_t limit_;
+    std::uint64_t inFlight_ = 0;
+    std::uint64_t peak_ = 0;
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+};
+
+/**
+ * @return the number of bytes in `text`, e.g. `4096`, `64K`, `256M` or `2G` (in powers of
+ *  1024), or std::nullopt if it isn't a size
+ */
+std::optional<std::uint64_t> parseByteSize(std::string_view text);
+
+/**
+ * @return the duration in `text`, e.g. `500ms`, `30s` or `2m` (seconds when there's no unit),
+ *  or std::nullopt if it isn't a duration
+ */
+std::optional<std::chrono::milliseconds> parseDuration(std::string_view text);
+
+}  // namespace checksec::cli
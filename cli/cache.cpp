@@ -0,0 +1,380 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <type_traits>
+#include <utility>
+
+#include "hash.h"
+
+#ifdef _WIN32
+#include <chrono>
+#include <functional>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace checksec::cli {
+
+namespace {
+constexpr char kMagic[8] = {'W', 'C', 'S', 'C', 'A', 'C', 'H', 'E'};
+constexpr std::uint32_t kVersion = 3;
+
+// NOTE: Large enough for a raw SHA256 digest, which is the largest that
+// Authenticode signatures use in practice.
+constexpr std::size_t kMaxDigestSize = 32;
+
+constexpr const char* kDigestAlgorithms[] = {"MD5", "SHA1", "SHA256", "Unknown"};
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint16_t recordSize;
+
+    // Results are only meaningful for the set of mitigations they were scanned with.
+    std::uint16_t mitigationCount;
+};
+
+std::uint64_t mix(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+}  // namespace
+
+struct ResultCache::Record {
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint64_t size;
+    std::int64_t mtimeNs;
+    std::uint64_t contentHash;
+    std::uint64_t presence;
+    std::uint64_t explanations;
+
+    // 0 for no digest, otherwise 1 + an index into kDigestAlgorithms.
+    std::uint8_t digestAlgorithm;
+    std::uint8_t digestSize;
+    std::uint8_t digest[kMaxDigestSize];
+    std::uint16_t targetMachine;
+    std::uint8_t is64Bit;
+    std::uint8_t reserved[3];
+};
+
+ResultCache::ResultCache(std::string path, bool hashContents)
+    : path_(std::move(path)), hashContents_(hashContents) {
+    load();
+}
+
+ResultCache::~ResultCache() { close(); }
+
+std::optional<ResultCache::Key> ResultCache::key(const std::string& path) const {
+    Key key{};
+
+#ifdef _WIN32
+    // NOTE: There's no cheap, portable inode equivalent on Windows, so we identify
+    // files by their path instead.
+    std::error_code ec;
+    std::filesystem::path fspath(path);
+    if (!std::filesystem::is_regular_file(fspath, ec)) {
+        return std::nullopt;
+    }
+    key.inode = std::hash<std::string>{}(std::filesystem::absolute(fspath, ec).string());
+    key.size = std::filesystem::file_size(fspath, ec);
+    auto mtime = std::filesystem::last_write_time(fspath, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    key.mtimeNs =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return std::nullopt;
+    }
+    key.device = static_cast<std::uint64_t>(st.st_dev);
+    key.inode = static_cast<std::uint64_t>(st.st_ino);
+    key.size = static_cast<std::uint64_t>(st.st_size);
+#ifdef __APPLE__
+    key.mtimeNs = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    key.mtimeNs = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+#endif
+
+    if (hashContents_) {
+        // NOTE: An unreadable file won't scan either, so any nonzero hash will do.
+        key.contentHash = hashFile(path).value_or(1);
+    }
+
+    return key;
+}
+
+std::optional<ScanResult> ResultCache::lookup(const Key& key) const {
+    const Record* record = find(key.device, key.inode);
+    if (record == nullptr || record->size != key.size || record->mtimeNs != key.mtimeNs ||
+        record->contentHash != key.contentHash) {
+        return std::nullopt;
+    }
+
+    ScanResult result{MitigationSummary(record->presence, record->explanations), std::nullopt,
+                      record->targetMachine, record->is64Bit != 0};
+    if (record->digestAlgorithm != 0) {
+        static constexpr char kHex[] = "0123456789abcdef";
+        std::string digest;
+        digest.reserve(record->digestSize * 2);
+        for (std::size_t i = 0; i < record->digestSize; ++i) {
+            digest += kHex[record->digest[i] >> 4];
+            digest += kHex[record->digest[i] & 0xf];
+        }
+        result.authenticodeDigest = AuthenticodeDigest{
+            kDigestAlgorithms[record->digestAlgorithm - 1],
+            std::move(digest),
+        };
+    }
+
+    return result;
+}
+
+void ResultCache::store(const Key& key, const ScanResult& result) {
+    static_assert(std::is_trivially_copyable_v<Record>);
+    static_assert(sizeof(Record) == 96, "cache records should be tightly packed");
+
+    Record record{};
+    record.device = key.device;
+    record.inode = key.inode;
+    record.size = key.size;
+    record.mtimeNs = key.mtimeNs;
+    record.contentHash = key.contentHash;
+    record.presence = result.summary.bits();
+    record.explanations = result.summary.explanationBits();
+    record.targetMachine = result.targetMachine;
+    record.is64Bit = result.is64Bit;
+
+    if (const auto& digest = result.authenticodeDigest) {
+        const auto* algorithm = std::find(std::begin(kDigestAlgorithms),
+                                          std::end(kDigestAlgorithms), digest->algorithm);
+        const auto& hex = digest->digest;
+        if (algorithm == std::end(kDigestAlgorithms) || hex.size() % 2 != 0 ||
+            hex.size() / 2 > kMaxDigestSize) {
+            // Can't be represented faithfully, so don't cache it at all.
+            return;
+        }
+
+        record.digestAlgorithm =
+            static_cast<std::uint8_t>(algorithm - std::begin(kDigestAlgorithms) + 1);
+        record.digestSize = static_cast<std::uint8_t>(hex.size() / 2);
+        for (std::size_t i = 0; i < record.digestSize; ++i) {
+            int hi = hexValue(hex[2 * i]);
+            int lo = hexValue(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0) {
+                return;
+            }
+            record.digest[i] = static_cast<std::uint8_t>((hi << 4) | lo);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(appendMutex_);
+    appended_.push_back(record);
+}
+
+void ResultCache::load() {
+#ifdef _WIN32
+    std::ifstream file(path_, std::ios::binary);
+    contents_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    const std::uint8_t* data = contents_.data();
+    std::size_t size = contents_.size();
+#else
+    int fd = ::open(path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            mapped_ = static_cast<const std::uint8_t*>(map);
+            mappedSize_ = static_cast<std::size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+    const std::uint8_t* data = mapped_;
+    std::size_t size = mappedSize_;
+#endif
+
+    if (size == 0) {
+        return;
+    }
+
+    Header header{};
+    if (size >= sizeof(header)) {
+        std::memcpy(&header, data, sizeof(header));
+    }
+    if (size < sizeof(header) || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion || header.recordSize != sizeof(Record) ||
+        header.mitigationCount != kMitigationCount) {
+        std::cerr << "Warn: ignoring incompatible cache " << path_ << "\n";
+        return;
+    }
+
+    // NOTE: A trailing partial record (e.g. from an interrupted write) is ignored, and the
+    // file is rewritten on close, since appending after it would misalign every later record.
+    records_ = reinterpret_cast<const Record*>(data + sizeof(Header));
+    recordCount_ = (size - sizeof(Header)) / sizeof(Record);
+    torn_ = (size - sizeof(Header)) % sizeof(Record) != 0;
+
+    std::size_t capacity = 16;
+    while (capacity < recordCount_ * 2) {
+        capacity *= 2;
+    }
+    index_.assign(capacity, 0);
+
+    for (std::size_t i = 0; i < recordCount_; ++i) {
+        const Record& record = records_[i];
+        std::size_t slot = mix(record.device ^ mix(record.inode)) & (capacity - 1);
+        for (;; slot = (slot + 1) & (capacity - 1)) {
+            if (index_[slot] == 0) {
+                ++liveCount_;
+                break;
+            }
+            const Record& other = records_[index_[slot] - 1];
+            if (other.device == record.device && other.inode == record.inode) {
+                break;
+            }
+        }
+        // Later records supersede earlier ones for the same file.
+        index_[slot] = static_cast<std::uint32_t>(i + 1);
+    }
+}
+
+const ResultCache::Record* ResultCache::find(std::uint64_t device, std::uint64_t inode) const {
+    if (index_.empty()) {
+        return nullptr;
+    }
+
+    std::size_t mask = index_.size() - 1;
+    for (std::size_t slot = mix(device ^ mix(inode)) & mask;; slot = (slot + 1) & mask) {
+        if (index_[slot] == 0) {
+            return nullptr;
+        }
+        const Record& record = records_[index_[slot] - 1];
+        if (record.device == device && record.inode == inode) {
+            return &record;
+        }
+    }
+}
+
+void ResultCache::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+
+    std::lock_guard<std::mutex> lock(appendMutex_);
+    bool compact =
+        (torn_ || recordCount_ + appended_.size() > 2 * std::max<std::size_t>(liveCount_, 1)) &&
+        recordCount_ > 0;
+
+    if (compact) {
+        // Keep only the newest record for each file: the existing records that weren't
+        // superseded during this run, followed by this run's records.
+        std::map<std::pair<std::uint64_t, std::uint64_t>, std::size_t> newest;
+        for (std::size_t i = 0; i < appended_.size(); ++i) {
+            newest[{appended_[i].device, appended_[i].inode}] = i;
+        }
+
+        std::vector<Record> live;
+        live.reserve(liveCount_ + newest.size());
+        for (auto slot : index_) {
+            if (slot != 0) {
+                const Record& record = records_[slot - 1];
+                if (newest.count({record.device, record.inode}) == 0) {
+                    live.push_back(record);
+                }
+            }
+        }
+        for (std::size_t i = 0; i < appended_.size(); ++i) {
+            if (newest[{appended_[i].device, appended_[i].inode}] == i) {
+                live.push_back(appended_[i]);
+            }
+        }
+        appended_ = std::move(live);
+    }
+
+#ifndef _WIN32
+    if (mapped_ != nullptr) {
+        ::munmap(const_cast<std::uint8_t*>(mapped_), mappedSize_);
+    }
+#endif
+    mapped_ = nullptr;
+    contents_.clear();
+    records_ = nullptr;
+    index_.clear();
+
+    bool fresh = recordCount_ == 0 || compact;
+    if (appended_.empty() && !fresh) {
+        return;
+    }
+
+    // NOTE: Rewrites go to a temporary file first, so that an interrupted run never leaves
+    // a truncated cache behind.
+    std::string target = fresh ? path_ + ".tmp" : path_;
+    std::FILE* file = std::fopen(target.c_str(), fresh ? "wb" : "ab");
+    if (file == nullptr) {
+        std::cerr << "Warn: couldn't write cache " << target << "\n";
+        return;
+    }
+
+    bool ok = true;
+    if (fresh) {
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.recordSize = sizeof(Record);
+        header.mitigationCount = kMitigationCount;
+        ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+    if (ok && !appended_.empty()) {
+        ok = std::fwrite(appended_.data(), sizeof(Record), appended_.size(), file) ==
+             appended_.size();
+    }
+    ok = std::fclose(file) == 0 && ok;
+
+    if (fresh) {
+        std::error_code ec;
+        if (ok) {
+            std::filesystem::rename(target, path_, ec);
+        }
+        if (!ok || ec) {
+            std::cerr << "Warn: couldn't write cache " << path_ << "\n";
+            std::filesystem::remove(target, ec);
+        }
+    } else if (!ok) {
+        std::cerr << "Warn: couldn't write cache " << path_ << "\n";
+    }
+    appended_.clear();
+}
+
+}  // namespace checksec::cli
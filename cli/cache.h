@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "result.h"
+
+namespace checksec::cli {
+
+/**
+ * A persistent cache of scan results, keyed by file identity.
+ *
+ * The cache file is a small header followed by fixed-size binary records, one per scanned file.
+ * Opening the cache maps the file and indexes its records in a single pass, without parsing
+ * anything; new results are appended when the cache is closed. Records are superseded rather
+ * than rewritten, and the file is compacted once superseded records outnumber live ones.
+ */
+class ResultCache {
+   public:
+    /**
+     * Identifies a particular version of a file on disk.
+     */
+    struct Key {
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::uint64_t size;
+        std::int64_t mtimeNs;
+
+        /**
+         * A hash of the file's contents, or 0 if contents aren't being hashed.
+         */
+        std::uint64_t contentHash;
+    };
+
+    /**
+     * @param path the path to the cache file, which is created if it doesn't exist
+     * @param hashContents whether keys should include a hash of each file's contents, for
+     *  filesystems where size and modification time can't be trusted
+     */
+    ResultCache(std::string path, bool hashContents);
+    ~ResultCache();
+
+    // can't make copies of ResultCache
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    /**
+     * @return the key for the file at `path` as it currently exists, or `std::nullopt` if the
+     *  file can't be examined
+     */
+    std::optional<Key> key(const std::string& path) const;
+
+    /**
+     * @return the cached result for `key`, if there is one
+     *
+     * @note Only results that were in the cache file when it was opened are returned.
+     */
+    std::optional<ScanResult> lookup(const Key& key) const;
+
+    /**
+     * Records `result` for `key`, to be written out when the cache is closed.
+     */
+    void store(const Key& key, const ScanResult& result);
+
+    /**
+     * Writes out any new results and releases the cache file.
+     */
+    void close();
+
+   private:
+    struct Record;
+
+    void load();
+    const Record* find(std::uint64_t device, std::uint64_t inode) const;
+
+    std::string path_;
+    bool hashContents_;
+
+    // The records from the existing cache file, either mapped or (where mapping isn't
+    // available) read into memory.
+    const std::uint8_t* mapped_ = nullptr;
+    std::size_t mappedSize_ = 0;
+    std::vector<std::uint8_t> contents_;
+    const Record* records_ = nullptr;
+    std::size_t recordCount_ = 0;
+
+    // Whether the file ends in a partial record, which rules out appending to it.
+    bool torn_ = false;
+
+    // Open-addressed index of (device, inode) to the most recent record for it, stored as
+    // record index + 1 so that 0 can mark an empty slot.
+    std::vector<std::uint32_t> index_;
+    std::size_t liveCount_ = 0;
+
+    std::mutex appendMutex_;
+    std::vector<Record> appended_;
+    bool closed_ = false;
+};
+
+}  // namespace checksec::cli
@@ -0,0 +1,110 @@
+#include "dedup.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "hash.h"
+
+namespace checksec::cli {
+
+namespace {
+bool sameContents(const std::string& a, const std::string& b) {
+    std::ifstream left(a, std::ios::binary);
+    std::ifstream right(b, std::ios::binary);
+    if (!left || !right) {
+        return false;
+    }
+
+    std::vector<char> lhs(64 * 1024);
+    std::vector<char> rhs(lhs.size());
+    for (;;) {
+        left.read(lhs.data(), lhs.size());
+        right.read(rhs.data(), rhs.size());
+        if (left.gcount() != right.gcount() ||
+            !std::equal(lhs.begin(), lhs.begin() + left.gcount(), rhs.begin())) {
+            return false;
+        }
+        if (left.gcount() == 0 || !left || !right) {
+            return !left.bad() && !right.bad() && left.eof() == right.eof();
+        }
+    }
+}
+}  // namespace
+
+ContentIndex::Content::Content(std::string path, std::uint64_t contentHash)
+    : path(std::move(path)), contentHash(contentHash), result(promise.get_future().share()) {}
+
+std::uint64_t ContentIndex::Content::hash() {
+    std::call_once(hashed, [this] {
+        if (contentHash == 0) {
+            contentHash = hashFile(path).value_or(0);
+        }
+    });
+    return contentHash;
+}
+
+const std::string& ContentIndex::Claim::ownerPath() const { return content_->path; }
+
+ContentIndex::Claim ContentIndex::claim(const std::string& path) {
+    // NOTE: Files we can't size or hash are never shared; the scan will report whatever's
+    // wrong with them.
+    std::error_code ec;
+    auto size = static_cast<std::uint64_t>(std::filesystem::file_size(path, ec));
+    if (ec) {
+        return Claim(std::make_shared<Content>(path), true);
+    }
+
+    std::shared_ptr<Content> first;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [it, inserted] = bySize_.try_emplace(size);
+        if (inserted) {
+            it->second = std::make_shared<Content>(path);
+            return Claim(it->second, true);
+        }
+        first = it->second;
+    }
+
+    // NOTE: Hashing happens outside the lock, so that claims of other sizes (and of other
+    // contents) don't wait on it.
+    auto hash = hashFile(path);
+    if (!hash) {
+        return Claim(std::make_shared<Content>(path), true);
+    }
+    auto firstHash = first->hash();
+
+    std::pair<std::uint64_t, std::uint64_t> key{size, *hash};
+    std::size_t checked = 0;
+    for (;;) {
+        std::vector<std::shared_ptr<Content>> candidates;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!first->indexed && firstHash != 0) {
+                byHash_[{size, firstHash}].push_back(first);
+                first->indexed = true;
+            }
+
+            auto& contents = byHash_[key];
+            if (checked == contents.size()) {
+                auto content = std::make_shared<Content>(path, *hash);
+                content->indexed = true;
+                contents.push_back(content);
+                return Claim(std::move(content), true);
+            }
+            candidates.assign(contents.begin() + checked, contents.end());
+        }
+
+        // NOTE: Comparing contents means reading both files again, but only happens for
+        // files that are (almost certainly) duplicates, which are then spared a scan.
+        for (const auto& candidate : candidates) {
+            if (sameContents(candidate->path, path)) {
+                return Claim(candidate, false);
+            }
+        }
+        checked += candidates.size();
+    }
+}
+
+}  // namespace checksec::cli
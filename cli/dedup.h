@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "result.h"
+
+namespace checksec::cli {
+
+/**
+ * Finds files with identical contents across a batch, so that each distinct file is only
+ * scanned once.
+ *
+ * Files are first grouped by size, and only hashed once a second file of the same size turns up;
+ * a file with a unique size is never read beyond what the scan itself reads. Hash matches are
+ * then confirmed byte-for-byte, so that a crafted collision can't borrow another file's result.
+ */
+class ContentIndex {
+    struct Content;
+
+   public:
+    /**
+     * A file's claim on its contents' result.
+     *
+     * The first file claiming some contents owns them, and scans them; every later claim waits
+     * for (and shares) the owner's result.
+     */
+    class Claim {
+       public:
+        bool owner() const { return owner_; }
+
+        /**
+         * @return the path of the file whose scan this claim's result comes from
+         */
+        const std::string& ownerPath() const;
+
+        /**
+         * Runs `scan` and publishes its result (or exception) if this claim owns its contents;
+         * otherwise, waits for the owner's.
+         *
+         * @throw whatever the owner's scan threw
+         */
+        template <typename Fn>
+        ScanResult resolve(Fn&& scan) const {
+            if (!owner_) {
+                return content_->result.get();
+            }
+
+            try {
+                auto result = scan();
+                content_->promise.set_value(result);
+                return result;
+            } catch (...) {
+                content_->promise.set_exception(std::current_exception());
+                throw;
+            }
+        }
+
+       private:
+        friend class ContentIndex;
+
+        Claim(std::shared_ptr<Content> content, bool owner)
+            : content_(std::move(content)), owner_(owner) {}
+
+        std::shared_ptr<Content> content_;
+        bool owner_;
+    };
+
+    /**
+     * Claims the contents of the file at `path`.
+     *
+     * @note Safe to call from multiple threads at once. Every owning claim must be resolved,
+     *       or the claims waiting on it will wait forever.
+     */
+    Claim claim(const std::string& path);
+
+   private:
+    struct Content {
+        explicit Content(std::string path, std::uint64_t contentHash = 0);
+
+        /**
+         * @return the hash of the owner's contents (hashing them on first use), or 0 if they
+         *  can't be read
+         */
+        std::uint64_t hash();
+
+        std::string path;
+        std::once_flag hashed;
+        std::uint64_t contentHash;
+
+        // Whether the content is in `byHash_`; guarded by `mutex_`.
+        bool indexed = false;
+
+        std::promise<ScanResult> promise;
+        std::shared_future<ScanResult> result;
+    };
+
+    std::mutex mutex_;
+
+    // The first file claimed with each size, which is only hashed once another file of the same
+    // size is claimed.
+    std::map<std::uint64_t, std::shared_ptr<Content>> bySize_;
+
+    // NOTE: Keyed by (size, hash). Distinct contents that collide are kept in the order they
+    // were claimed; entries are only ever appended.
+    std::map<std::pair<std::uint64_t, std::uint64_t>, std::vector<std::shared_ptr<Content>>>
+        byHash_;
+};
+
+}  // namespace checksec::cli
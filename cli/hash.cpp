@@ -0,0 +1,129 @@
+#include "hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace checksec::cli {
+
+namespace {
+// Per-lane keys; arbitrary odd constants (the first eight 64-bit words of pi's fraction).
+constexpr std::uint64_t kKeys[8] = {
+    0x243f6a8885a308d3ULL, 0x13198a2e03707344ULL, 0xa4093822299f31d0ULL, 0x082efa98ec4e6c89ULL,
+    0x452821e638d01377ULL, 0xbe5466cf34e90c6cULL, 0xc0ac29b7c97c50ddULL, 0x3f84d5b5b5470917ULL,
+};
+
+constexpr std::uint64_t kPrime32 = 0x9e3779b1ULL;
+constexpr std::uint64_t kPrime64 = 0x9e3779b97f4a7c15ULL;
+
+// NOTE: The lanes are scrambled every 16 stripes (1 KiB), so that their high bits keep
+// feeding back into the low bits that the multiplies consume.
+constexpr std::uint64_t kStripesPerScramble = 16;
+
+std::uint64_t load64(const std::uint8_t* p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+std::uint64_t mix(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+}  // namespace
+
+ContentHasher::ContentHasher() {
+    for (std::size_t i = 0; i < kLanes; ++i) {
+        lanes_[i] = kKeys[i] * kPrime64;
+    }
+}
+
+void ContentHasher::stripe(const std::uint8_t* data) {
+    // NOTE: Each lane takes its neighbour's raw word as well as its own product, as in
+    // XXH3, so that a zero product can't erase a word's contribution. The products are formed
+    // in a pass of their own, so that neither loop writes a lane that another iteration reads.
+    std::uint64_t words[kLanes];
+    std::uint64_t products[kLanes];
+    std::memcpy(words, data, sizeof(words));
+    for (std::size_t i = 0; i < kLanes; ++i) {
+        std::uint64_t keyed = words[i] ^ kKeys[i];
+        products[i] = (keyed & 0xffffffffULL) * (keyed >> 32);
+    }
+    for (std::size_t i = 0; i < kLanes; ++i) {
+        lanes_[i] += products[i] + words[i ^ 1];
+    }
+
+    if (++stripes_ % kStripesPerScramble == 0) {
+        for (std::size_t i = 0; i < kLanes; ++i) {
+            lanes_[i] = (lanes_[i] ^ (lanes_[i] >> 47) ^ kKeys[i]) * kPrime32;
+        }
+    }
+}
+
+void ContentHasher::update(const std::uint8_t* data, std::size_t size) {
+    length_ += size;
+
+    if (pendingSize_ != 0) {
+        std::size_t n = std::min(size, kStripe - pendingSize_);
+        std::memcpy(pending_ + pendingSize_, data, n);
+        pendingSize_ += n;
+        data += n;
+        size -= n;
+        if (pendingSize_ < kStripe) {
+            return;
+        }
+        stripe(pending_);
+        pendingSize_ = 0;
+    }
+
+    for (; size >= kStripe; data += kStripe, size -= kStripe) {
+        stripe(data);
+    }
+
+    std::memcpy(pending_, data, size);
+    pendingSize_ = size;
+}
+
+std::uint64_t ContentHasher::digest() const {
+    std::uint64_t h = mix(length_ * kPrime64);
+    for (std::size_t i = 0; i < kLanes; ++i) {
+        h = mix(h ^ lanes_[i]) * kPrime64;
+    }
+
+    std::size_t i = 0;
+    for (; i + 8 <= pendingSize_; i += 8) {
+        h = mix(h ^ load64(pending_ + i)) * kPrime64;
+    }
+    for (; i < pendingSize_; ++i) {
+        h = (h ^ pending_[i]) * 0x100000001b3ULL;
+    }
+
+    // NOTE: 0 is reserved for "not hashed".
+    h = mix(h);
+    return h == 0 ? 1 : h;
+}
+
+std::optional<std::uint64_t> hashFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+
+    ContentHasher hasher;
+    std::vector<char> chunk(64 * 1024);
+    while (file.read(chunk.data(), chunk.size()) || file.gcount() > 0) {
+        hasher.update(reinterpret_cast<const std::uint8_t*>(chunk.data()),
+                      static_cast<std::size_t>(file.gcount()));
+    }
+    if (file.bad()) {
+        return std::nullopt;
+    }
+    return hasher.digest();
+}
+
+}  // namespace checksec::cli
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace checksec::cli {
+
+/**
+ * A fast, streaming, non-cryptographic hash of file contents.
+ *
+ * Input is consumed in 64-byte stripes across eight 64-bit lanes. Each lane adds a
+ * 32x32->64-bit product of its own keyed word, plus its neighbour's raw word. The products
+ * and the additions are separate passes, neither of which writes anything that another
+ * iteration of it reads, so both vectorize (SSE2/AVX2/NEON) without any platform-specific
+ * code.
+ *
+ * @note Not suitable for detecting deliberate collisions: callers that act on a match should
+ *       compare the contents themselves.
+ */
+class ContentHasher {
+   public:
+    ContentHasher();
+
+    void update(const std::uint8_t* data, std::size_t size);
+
+    /**
+     * @return the hash of everything passed to `update()` so far; never 0
+     */
+    std::uint64_t digest() const;
+
+   private:
+    static constexpr std::size_t kStripe = 64;
+    static constexpr std::size_t kLanes = kStripe / 8;
+
+    void stripe(const std::uint8_t* data);
+
+    std::uint64_t lanes_[kLanes];
+    std::uint8_t pending_[kStripe];
+    std::size_t pendingSize_ = 0;
+    std::uint64_t stripes_ = 0;
+    std::uint64_t length_ = 0;
+};
+
+/**
+ * @return the ContentHasher digest of the file at `path`, or `std::nullopt` if it can't be read
+ */
+std::optional<std::uint64_t> hashFile(const std::string& path);
+
+}  // namespace checksec::cli
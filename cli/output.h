@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace checksec::cli {
+
+/**
+ * Accumulates rendered results and writes them to an output stream in bounded chunks.
+ *
+ * Batching keeps the number of writes low on large scans, while the chunk bound keeps memory
+ * constant and lets downstream consumers see results while the scan is still running.
+ */
+class ChunkedWriter {
+   public:
+    explicit ChunkedWriter(std::ostream& os, std::size_t chunk = 64 * 1024)
+        : os_(os), chunk_(chunk) {
+        buffer_.reserve(chunk_);
+    }
+
+    ~ChunkedWriter() { flush(); }
+
+    // can't make copies of ChunkedWriter
+    ChunkedWriter(const ChunkedWriter&) = delete;
+    ChunkedWriter& operator=(const ChunkedWriter&) = delete;
+
+    /**
+     * Appends `data`, writing out the buffer once it reaches the chunk size.
+     */
+    void write(std::string_view data) {
+        buffer_.append(data);
+        if (buffer_.size() >= chunk_) {
+            flush();
+        }
+    }
+
+    /**
+     * Writes out and flushes anything currently buffered.
+     */
+    void flush() {
+        if (buffer_.empty()) {
+            return;
+        }
+        os_.write(buffer_.data(), buffer_.size());
+        os_.flush();
+        buffer_.clear();
+    }
+
+   private:
+    std::ostream& os_;
+    std::size_t chunk_;
+    std::string buffer_;
+};
+
+}  // namespace checksec::cli
@@ -0,0 +1,57 @@
+#include "policy.h"
+
+#include <fstream>
+#include <iterator>
+
+#include "render.h"
+
+namespace checksec::cli {
+
+Policy::Policy(std::string_view mitigations) : checks_(parseMitigationList(mitigations)) {
+    if (checks_ == 0) {
+        throw ChecksecError("policy doesn't require any mitigations");
+    }
+
+    // NOTE: Kept in output order, regardless of the order they were named in.
+    for (const auto& field : kMitigationFields) {
+        if (checks_ & checkMask(field.mitigation)) {
+            required_.push_back(field.mitigation);
+        }
+    }
+}
+
+Policy Policy::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw ChecksecError(("couldn't open policy " + path).c_str());
+    }
+    std::string contents(std::istreambuf_iterator<char>(file), {});
+    return Policy(contents);
+}
+
+bool Policy::violations(std::string& out, std::string_view path,
+                        const MitigationSummary& summary) const {
+    bool violated = false;
+    for (auto mitigation : required_) {
+        auto presence = summary.presence(mitigation);
+        if (presence == MitigationPresence::Present ||
+            presence == MitigationPresence::NotApplicable) {
+            continue;
+        }
+
+        if (!violated) {
+            out.append(path).append(1, ':');
+            violated = true;
+        }
+        out.append(1, ' ')
+            .append(kMitigationFields[static_cast<std::size_t>(mitigation)].key)
+            .append(1, '=')
+            .append(presenceName(presence));
+    }
+    if (violated) {
+        out.append(1, '\n');
+    }
+    return violated;
+}
+
+}  // namespace checksec::cli
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "checksec.h"
+
+namespace checksec::cli {
+
+/**
+ * A set of mitigations that every scanned file is required to have.
+ *
+ * A requirement is met when the mitigation is present, or when it doesn't apply to the file
+ * (e.g. SafeSEH on a 64-bit image).
+ */
+class Policy {
+   public:
+    /**
+     * @param mitigations the required mitigations' keys, as for parseMitigationList, e.g.
+     *  `"cfg,gs,nx,aslr"`
+     * @throw ChecksecError if a key doesn't name a mitigation, or no mitigations are named
+     */
+    explicit Policy(std::string_view mitigations);
+
+    /**
+     * @return a policy read from the file at `path`, in the same format as the constructor
+     * @throw ChecksecError if the file can't be read, or doesn't hold a valid policy
+     */
+    static Policy load(const std::string& path);
+
+    /**
+     * @return the required mitigations, in output order
+     */
+    const std::vector<Mitigation>& required() const { return required_; }
+
+    /**
+     * @return the checks needed to evaluate the policy
+     */
+    CheckMask checks() const { return checks_; }
+
+    /**
+     * Appends a violation line for `path` to `out` (e.g. `foo.exe: cfg=NotPresent gs=NotPresent`)
+     * if `summary` doesn't meet the policy.
+     *
+     * @return whether `summary` violates the policy
+     */
+    bool violations(std::string& out, std::string_view path,
+                    const MitigationSummary& summary) const;
+
+   private:
+    CheckMask checks_;
+    std::vector<Mitigation> required_;
+};
+
+}  // namespace checksec::cli
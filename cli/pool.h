@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace checksec::cli {
+
+/**
+ * A fixed-size, work-stealing pool of workers whose results are handed back in submission order.
+ *
+ * Each worker owns a deque of pending inputs: `submit()` deals inputs out round-robin, a worker
+ * takes from the front of its own deque, and an idle worker steals from the back of its peers'.
+ * A worker that gets stuck on one expensive input therefore doesn't strand the inputs queued
+ * behind it.
+ *
+ * Results (or the exception thrown while producing them) are buffered until every earlier input
+ * has been returned by `next()`, which keeps output deterministic regardless of scheduling.
+ */
+template <typename Input, typename Result>
+class OrderedPool {
+   public:
+    using Work = std::function<Result(const Input&)>;
+
+    OrderedPool(std::size_t jobs, Work work) : work_(std::move(work)) {
+        if (jobs == 0) {
+            jobs = 1;
+        }
+        for (std::size_t i = 0; i < jobs; ++i) {
+            queues_.emplace_back(std::make_unique<Queue>());
+        }
+        for (std::size_t i = 0; i < jobs; ++i) {
+            workers_.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~OrderedPool() {
+        {
+            std::lock_guard<std::mutex> lock(idleMutex_);
+            stop_ = true;
+        }
+        idleCv_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    // can't make copies of OrderedPool
+    OrderedPool(const OrderedPool&) = delete;
+    OrderedPool& operator=(const OrderedPool&) = delete;
+
+    /**
+     * @return the number of workers in the pool
+     */
+    std::size_t jobs() const { return workers_.size(); }
+
+    /**
+     * Queues `input` for scanning.
+     */
+    void submit(Input input) {
+        auto& queue = *queues_[submitted_ % queues_.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back({submitted_, std::move(input)});
+        }
+        ++submitted_;
+        {
+            std::lock_guard<std::mutex> lock(idleMutex_);
+            ++queued_;
+        }
+        idleCv_.notify_one();
+    }
+
+    /**
+     * Abandons every queued input. Workers exit once they're done with the input they're working
+     * on (which they can abandon early by watching \ref cancellation), and `next()` and
+     * `tryNext()` return `std::nullopt` from then on.
+     *
+     * @note Safe to call from any thread, including from a worker.
+     */
+    void cancel() {
+        {
+            std::lock_guard<std::mutex> lock(idleMutex_);
+            stop_ = true;
+        }
+        idleCv_.notify_all();
+        {
+            std::lock_guard<std::mutex> lock(doneMutex_);
+            cancelled_ = true;
+        }
+        doneCv_.notify_all();
+    }
+
+    /**
+     * @return whether `cancel()` has been called
+     */
+    bool cancelled() const { return cancelled_; }
+
+    /**
+     * @return the flag that `cancel()` sets, for work to poll while it's in progress
+     */
+    const std::atomic<bool>& cancellation() const { return cancelled_; }
+
+    /**
+     * @return the number of inputs submitted but not yet returned by `next()`
+     */
+    std::size_t pending() const { return submitted_ - returned_; }
+
+    /**
+     * @return the next result in submission order if it's already available, or `std::nullopt`
+     *
+     * @note Rethrows any exception raised while producing the result.
+     */
+    std::optional<Result> tryNext() {
+        std::unique_lock<std::mutex> lock(doneMutex_);
+        if (cancelled_ || pending() == 0 || done_.find(returned_) == done_.end()) {
+            return std::nullopt;
+        }
+        return take(lock);
+    }
+
+    /**
+     * @return the next result in submission order, waiting for it if necessary, or `std::nullopt`
+     *  if there are no pending inputs (or the pool has been cancelled)
+     *
+     * @note Rethrows any exception raised while producing the result.
+     */
+    std::optional<Result> next() {
+        std::unique_lock<std::mutex> lock(doneMutex_);
+        if (cancelled_ || pending() == 0) {
+            return std::nullopt;
+        }
+        doneCv_.wait(lock, [this] { return cancelled_ || done_.find(returned_) != done_.end(); });
+        if (cancelled_) {
+            return std::nullopt;
+        }
+        return take(lock);
+    }
+
+   private:
+    struct Task {
+        std::size_t seq;
+        Input input;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct Slot {
+        std::optional<Result> result;
+        std::exception_ptr error;
+    };
+
+    std::optional<Result> take(std::unique_lock<std::mutex>& lock) {
+        auto it = done_.find(returned_);
+        Slot slot = std::move(it->second);
+        done_.erase(it);
+        ++returned_;
+        lock.unlock();
+
+        if (slot.error) {
+            std::rethrow_exception(slot.error);
+        }
+        return std::move(slot.result);
+    }
+
+    std::optional<Task> pop(std::size_t self) {
+        {
+            auto& own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                Task task = std::move(own.tasks.front());
+                own.tasks.pop_front();
+                return task;
+            }
+        }
+
+        for (std::size_t i = 1; i < queues_.size(); ++i) {
+            auto& victim = *queues_[(self + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                Task task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                return task;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    void run(std::size_t self) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(idleMutex_);
+                idleCv_.wait(lock, [this] { return stop_ || queued_ > 0; });
+                if (stop_) {
+                    return;
+                }
+                // Claim a task before looking for it: every claim is backed by a task that
+                // was queued before the count was bumped, so the search below always succeeds.
+                --queued_;
+            }
+
+            std::optional<Task> task;
+            while (!(task = pop(self))) {
+                std::this_thread::yield();
+            }
+
+            Slot slot;
+            try {
+                slot.result.emplace(work_(task->input));
+            } catch (...) {
+                slot.error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(doneMutex_);
+                done_.emplace(task->seq, std::move(slot));
+            }
+            doneCv_.notify_all();
+        }
+    }
+
+    Work work_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex idleMutex_;
+    std::condition_variable idleCv_;
+    std::size_t queued_ = 0;
+    bool stop_ = false;
+
+    std::mutex doneMutex_;
+    std::condition_variable doneCv_;
+    std::unordered_map<std::size_t, Slot> done_;
+    std::atomic<bool> cancelled_{false};
+
+    std::atomic<std::size_t> submitted_{0};
+    std::atomic<std::size_t> returned_{0};
+};
+
+}  // namespace checksec::cli
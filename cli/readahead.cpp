@@ -0,0 +1,388 @@
+#include "readahead.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define WINCHECKSEC_IO_URING
+#endif
+#endif
+
+namespace checksec::cli {
+
+namespace {
+// NOTE: Past this many queued files, read-ahead is so far behind the scans that the oldest
+// ones are no longer worth reading.
+constexpr std::size_t kQueuedPerSlot = 4;
+
+// io_uring refuses rings larger than this, and blocking reads don't need more threads.
+constexpr std::size_t kMaxRingDepth = 4096;
+constexpr std::size_t kMaxThreads = 64;
+}  // namespace
+
+#ifdef WINCHECKSEC_IO_URING
+
+/**
+ * A minimal io_uring, driven through the raw system calls so that we don't need liburing.
+ *
+ * @note Only a single thread may use a ring.
+ */
+class ReadAhead::Ring {
+   public:
+    explicit Ring(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        // NOTE: Opens and reads through io_uring arrived in Linux 5.6, along with this
+        // feature flag.
+        if (fd_ < 0 || !(params.features & IORING_FEAT_RW_CUR_POS)) {
+            reset();
+            return;
+        }
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+
+        sqRing_ = map(sqRingSize_, IORING_OFF_SQ_RING);
+        cqRing_ = singleMap ? sqRing_ : map(cqRingSize_, IORING_OFF_CQ_RING);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqesSize_, IORING_OFF_SQES));
+        if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+            reset();
+            return;
+        }
+
+        auto* sq = static_cast<std::uint8_t*>(sqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        auto* cq = static_cast<std::uint8_t*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~Ring() { reset(); }
+
+    // can't make copies of Ring
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    bool ok() const { return fd_ >= 0; }
+
+    /**
+     * @return a zeroed submission, sent with the next call to \ref submitAndWait
+     *
+     * @note The caller must never have more submissions in flight than the ring has entries.
+     */
+    io_uring_sqe* prepare() {
+        unsigned index = (*sqTail_ + prepared_++) & sqMask_;
+        sqArray_[index] = index;
+        std::memset(&sqes_[index], 0, sizeof(io_uring_sqe));
+        return &sqes_[index];
+    }
+
+    /**
+     * Sends the prepared submissions, and waits for at least one completion.
+     *
+     * @return false if the kernel refused the submissions
+     */
+    bool submitAndWait() {
+        unsigned count = prepared_;
+        __atomic_store_n(sqTail_, *sqTail_ + prepared_, __ATOMIC_RELEASE);
+        prepared_ = 0;
+
+        for (;;) {
+            long submitted = ::syscall(__NR_io_uring_enter, fd_, count, 1,
+                                       IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (submitted >= 0) {
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN) {
+                return false;
+            }
+            // NOTE: An interrupted wait has still consumed every submission.
+            if (errno == EINTR) {
+                count = 0;
+            }
+        }
+    }
+
+    /**
+     * Calls `handle(userData, result)` for each completion that's arrived.
+     */
+    template <typename Handler>
+    void reap(Handler&& handle) {
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            handle(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+
+   private:
+    void* map(std::size_t size, off_t offset) {
+        return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                      offset);
+    }
+
+    void reset() {
+        if (sqes_ != MAP_FAILED) {
+            ::munmap(sqes_, sqesSize_);
+        }
+        if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+            ::munmap(cqRing_, cqRingSize_);
+        }
+        if (sqRing_ != MAP_FAILED) {
+            ::munmap(sqRing_, sqRingSize_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+        sqRing_ = cqRing_ = MAP_FAILED;
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    void* sqRing_ = MAP_FAILED;
+    void* cqRing_ = MAP_FAILED;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t sqRingSize_ = 0;
+    std::size_t cqRingSize_ = 0;
+    std::size_t sqesSize_ = 0;
+
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* sqArray_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned prepared_ = 0;
+};
+
+#else
+
+class ReadAhead::Ring {};
+
+#endif
+
+ReadAhead::ReadAhead(std::size_t depth, CheckMask checks, bool wholeFiles)
+    : depth_(std::clamp<std::size_t>(depth, 1, kMaxRingDepth)),
+      checks_(checks),
+      wholeFiles_(wholeFiles) {
+#ifdef WINCHECKSEC_IO_URING
+    auto ring = std::make_unique<Ring>(static_cast<unsigned>(depth_));
+    if (ring->ok()) {
+        ring_ = std::move(ring);
+        backend_ = "io_uring";
+        threads_.emplace_back([this] { runRing(); });
+        return;
+    }
+#endif
+
+#ifdef __linux__
+    backend_ = "threads";
+    for (std::size_t i = 0; i < std::min(depth_, kMaxThreads); ++i) {
+        threads_.emplace_back([this] { runThread(); });
+    }
+#endif
+}
+
+ReadAhead::~ReadAhead() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queued_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ReadAhead::submit(const std::string& path) {
+    if (threads_.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= depth_ * kQueuedPerSlot) {
+            queue_.pop_front();
+        }
+        queue_.push_back(path);
+    }
+    queued_.notify_one();
+}
+
+std::optional<std::string> ReadAhead::take(bool wait) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (wait) {
+        queued_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    }
+
+    // NOTE: Once we're stopping, the scans are over, so whatever's left isn't worth reading.
+    if (stopping_ || queue_.empty()) {
+        return std::nullopt;
+    }
+    std::string path = std::move(queue_.front());
+    queue_.pop_front();
+    return path;
+}
+
+#ifdef __linux__
+
+void ReadAhead::advise(int fd, const std::uint8_t* headers, std::size_t size) const {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        return;
+    }
+
+    // NOTE: WILLNEED starts asynchronous readahead of the range and returns; the scan's own
+    // reads then wait (if at all) on I/O that's already underway.
+    if (wholeFiles_) {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        return;
+    }
+    auto ranges =
+        Checksec::plannedReads(headers, size, static_cast<std::uint64_t>(st.st_size), checks_);
+    for (const auto& range : ranges) {
+        ::posix_fadvise(fd, static_cast<off_t>(range.offset), static_cast<off_t>(range.size),
+                        POSIX_FADV_WILLNEED);
+    }
+}
+
+void ReadAhead::runThread() {
+    std::vector<std::uint8_t> headers(impl::kHeaderReadSize);
+    while (auto path = take(true)) {
+        int fd = ::open(path->c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        auto size = ::pread(fd, headers.data(), headers.size(), 0);
+        if (size > 0) {
+            advise(fd, headers.data(), static_cast<std::size_t>(size));
+        }
+        ::close(fd);
+        ++files_;
+    }
+}
+
+#else
+
+void ReadAhead::advise(int, const std::uint8_t*, std::size_t) const {}
+
+void ReadAhead::runThread() {}
+
+#endif
+
+#ifdef WINCHECKSEC_IO_URING
+
+void ReadAhead::runRing() {
+    struct Slot {
+        std::string path;
+        int fd;
+        std::uint8_t headers[impl::kHeaderReadSize];
+    };
+
+    // NOTE: Each slot has a single request in flight at a time: first its open, then its
+    // read. The request's user data is the slot's index, with the low bit set for reads.
+    std::unique_ptr<Slot[]> slots(new Slot[depth_]);
+    std::vector<std::size_t> idle(depth_);
+    for (std::size_t i = 0; i < depth_; ++i) {
+        idle[i] = depth_ - 1 - i;
+    }
+    std::size_t inFlight = 0;
+
+    for (;;) {
+        // Wait for more files only when there's nothing in flight to wait on instead. Files
+        // submitted while we're waiting on the ring are picked up as soon as anything completes.
+        while (!idle.empty()) {
+            auto path = take(inFlight == 0);
+            if (!path) {
+                break;
+            }
+
+            std::size_t index = idle.back();
+            idle.pop_back();
+            Slot& slot = slots[index];
+            slot.path = std::move(*path);
+
+            io_uring_sqe* sqe = ring_->prepare();
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<std::uintptr_t>(slot.path.c_str());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = index << 1;
+            ++inFlight;
+        }
+
+        if (inFlight == 0) {
+            return;
+        }
+
+        if (!ring_->submitAndWait()) {
+            // NOTE: The kernel may still be writing into the slots, so they (and the ring)
+            // are left alone for the rest of the process's life.
+            std::cerr << "Warn: read-ahead stopped: " << std::strerror(errno) << "\n";
+            slots.release();
+            ring_.release();
+            return;
+        }
+
+        ring_->reap([&](std::uint64_t data, std::int32_t result) {
+            std::size_t index = data >> 1;
+            Slot& slot = slots[index];
+            bool read = data & 1;
+            if (!read && result >= 0) {
+                slot.fd = result;
+                io_uring_sqe* sqe = ring_->prepare();
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = slot.fd;
+                sqe->addr = reinterpret_cast<std::uintptr_t>(slot.headers);
+                sqe->len = sizeof(slot.headers);
+                sqe->off = 0;
+                sqe->user_data = data | 1;
+                return;
+            }
+
+            if (read) {
+                if (result > 0) {
+                    advise(slot.fd, slot.headers, static_cast<std::size_t>(result));
+                }
+                ::close(slot.fd);
+                ++files_;
+            }
+            idle.push_back(index);
+            --inFlight;
+        });
+    }
+}
+
+#else
+
+void ReadAhead::runRing() {}
+
+#endif
+
+}  // namespace checksec::cli
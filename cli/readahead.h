@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "checksec.h"
+
+namespace checksec::cli {
+
+/**
+ * Reads files ahead of their scans, so that each scan finds its file in the page cache instead
+ * of waiting on storage (most of all, on network filesystems).
+ *
+ * Each file is opened and has its headers read, and the kernel is then told (with
+ * `posix_fadvise`) which other ranges its scan will read; see Checksec::plannedReads. Opens and
+ * reads are batched through io_uring, with up to `depth` files in flight at once. Where
+ * io_uring isn't available (kernels before 5.6, or a seccomp policy that forbids it), a pool of
+ * threads does blocking reads instead.
+ *
+ * Read-ahead is only supported on Linux; elsewhere, submitted files are ignored.
+ */
+class ReadAhead {
+   public:
+    /**
+     * @param depth the most files to have in flight at once
+     * @param checks the checks that the scans will run, which decide the ranges they read
+     * @param wholeFiles whether the scans will read every file in full, e.g. to scan its code
+     */
+    ReadAhead(std::size_t depth, CheckMask checks, bool wholeFiles);
+    ~ReadAhead();
+
+    // can't make copies of ReadAhead
+    ReadAhead(const ReadAhead&) = delete;
+    ReadAhead& operator=(const ReadAhead&) = delete;
+
+    /**
+     * Queues a file to be read ahead. Never waits on I/O.
+     *
+     * If read-ahead has fallen far behind, the oldest queued file is dropped instead, since its
+     * scan has most likely started already.
+     */
+    void submit(const std::string& path);
+
+    /**
+     * @return the backend in use: `io_uring`, `threads`, or `none`
+     */
+    const char* backend() const { return backend_; }
+
+    /**
+     * @return the number of files read ahead so far
+     */
+    std::uint64_t files() const { return files_; }
+
+   private:
+    class Ring;
+
+    std::optional<std::string> take(bool wait);
+    void advise(int fd, const std::uint8_t* headers, std::size_t size) const;
+    void runRing();
+    void runThread();
+
+    std::size_t depth_;
+    CheckMask checks_;
+    bool wholeFiles_;
+    std::unique_ptr<Ring> ring_;
+    const char* backend_ = "none";
+    std::atomic<std::uint64_t> files_{0};
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::deque<std::string> queue_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace checksec::cli
@@ -0,0 +1,228 @@
+#include "render.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace checksec {
+void to_json(json& j, const MitigationPresence& p) { j = std::string(cli::presenceName(p)); }
+
+void to_json(json& j, const MitigationReport& r) {
+    // NOTE: Our vendored JSON predates string_view support.
+    j = {
+        {"presence", r.presence},
+        {"description", std::string(r.description)},
+    };
+
+    if (r.explanation) {
+        j["explanation"] = std::string(r.explanation.value());
+    }
+}
+
+namespace cli {
+namespace {
+bool equalsIgnoringCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) ==
+                      std::tolower(static_cast<unsigned char>(y));
+           });
+}
+}  // namespace
+
+const MitigationField* findMitigationField(std::string_view key) {
+    for (const auto& field : kMitigationFields) {
+        if (equalsIgnoringCase(field.key, key)) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+CheckMask parseMitigationList(std::string_view list) {
+    CheckMask checks = 0;
+    std::size_t pos = 0;
+    while (pos < list.size()) {
+        char c = list[pos];
+        if (c == '#') {
+            pos = std::min(list.find('\n', pos), list.size());
+            continue;
+        }
+        if (c == ',' || std::isspace(static_cast<unsigned char>(c))) {
+            ++pos;
+            continue;
+        }
+
+        auto end = list.find_first_of(", \t\r\n#", pos);
+        auto key = list.substr(pos, end == std::string_view::npos ? end : end - pos);
+        const auto* field = findMitigationField(key);
+        if (field == nullptr) {
+            throw ChecksecError(("unknown mitigation: " + std::string(key)).c_str());
+        }
+        checks |= checkMask(field->mitigation);
+        pos += key.size();
+    }
+    return checks;
+}
+
+std::optional<MitigationPresence> findPresence(std::string_view name) {
+    for (auto presence : {MitigationPresence::Present, MitigationPresence::NotPresent,
+                          MitigationPresence::NotApplicable, MitigationPresence::NotImplemented}) {
+        if (equalsIgnoringCase(presenceName(presence), name)) {
+            return presence;
+        }
+    }
+    return std::nullopt;
+}
+
+void to_json(json& j, const ScanResult& r) {
+    if (r.status != ScanStatus::Scanned) {
+        j = {
+            {"status", std::string(statusName(r.status))},
+        };
+        return;
+    }
+
+    auto mitigations = json::object();
+    for (const auto& field : kMitigationFields) {
+        mitigations[std::string(field.key)] = MitigationReport{
+            r.summary.presence(field.mitigation),
+            description(field.mitigation),
+            r.summary.explanation(field.mitigation),
+        };
+    }
+
+    j = {
+        {"mitigations", mitigations},
+    };
+
+    if (r.authenticodeDigest) {
+        j["authenticodeDigest"] = {
+            {"algorithm", r.authenticodeDigest->algorithm},
+            {"digest", r.authenticodeDigest->digest},
+        };
+    }
+
+    if (r.gsInstrumentation) {
+        j["gsInstrumentation"] = {
+            {"functions", r.gsInstrumentation->functions},
+            {"instrumented", r.gsInstrumentation->instrumented},
+            {"checks", r.gsInstrumentation->checks},
+            {"fraction", r.gsInstrumentation->fraction()},
+        };
+    }
+
+    if (r.riskyImports) {
+        auto imports = json::array();
+        for (const auto& finding : *r.riskyImports) {
+            imports.push_back({
+                {"module", finding.module},
+                {"function", std::string(finding.function)},
+                {"risk", std::string(apiRiskName(finding.risk))},
+                {"description", std::string(description(finding.risk))},
+                {"delayLoaded", finding.delayLoaded},
+            });
+        }
+        j["riskyImports"] = imports;
+    }
+}
+}  // namespace cli
+
+void to_json(json& j, const Checksec& c) {
+    j = cli::ScanResult::from(c);
+    j["path"] = c.filepath();
+}
+
+std::ostream& operator<<(std::ostream& os, Checksec& self) {
+    std::string out;
+    cli::renderText(out, cli::ScanResult::from(self));
+    return os << out;
+}
+
+namespace cli {
+void renderText(std::string& out, const ScanResult& r) {
+    if (r.status != ScanStatus::Scanned) {
+        out.append("Status          : \"").append(statusName(r.status)).append("\"\n");
+        return;
+    }
+
+    // NOTE: Presence values are quoted, as they were when this was rendered from JSON.
+    for (const auto& field : kMitigationFields) {
+        out.append(field.label).append(": \"");
+        out.append(presenceName(r.summary.presence(field.mitigation))).append("\"\n");
+    }
+
+    if (r.gsInstrumentation) {
+        out.append("GS Instrumented : ")
+            .append(std::to_string(r.gsInstrumentation->instrumented))
+            .append("/")
+            .append(std::to_string(r.gsInstrumentation->functions))
+            .append(" functions\n");
+    }
+
+    if (r.riskyImports) {
+        for (const auto& finding : *r.riskyImports) {
+            out.append("Risky Import    : ")
+                .append(finding.module)
+                .append("!")
+                .append(finding.function)
+                .append(" (")
+                .append(apiRiskName(finding.risk))
+                .append(finding.delayLoaded ? ", delay-loaded)\n" : ")\n");
+        }
+    }
+}
+
+void renderDelimitedHeader(std::string& out, char delimiter) {
+    out.append("path");
+    for (const auto& field : kMitigationFields) {
+        out.append(1, delimiter).append(field.key);
+    }
+    out.append(1, '\n');
+}
+
+void renderDelimited(std::string& out, std::string_view path, const ScanResult& r,
+                     char delimiter) {
+    if (delimiter == '\t') {
+        for (char c : path) {
+            switch (c) {
+                case '\t': {
+                    out.append("\\t");
+                    break;
+                }
+                case '\n': {
+                    out.append("\\n");
+                    break;
+                }
+                case '\r': {
+                    out.append("\\r");
+                    break;
+                }
+                case '\\': {
+                    out.append("\\\\");
+                    break;
+                }
+                default: {
+                    out.append(1, c);
+                    break;
+                }
+            }
+        }
+    } else if (path.find_first_of(std::string{delimiter, '"', '\n', '\r'}) != path.npos) {
+        out.append(1, '"');
+        for (char c : path) {
+            out.append(c == '"' ? 2 : 1, c);
+        }
+        out.append(1, '"');
+    } else {
+        out.append(path);
+    }
+
+    for (const auto& field : kMitigationFields) {
+        out.append(1, delimiter)
+            .append(r.status == ScanStatus::Scanned
+                        ? presenceName(r.summary.presence(field.mitigation))
+                        : statusName(r.status));
+    }
+    out.append(1, '\n');
+}
+}  // namespace cli
+}  // namespace checksec
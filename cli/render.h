@@ -0,0 +1,163 @@
+#pragma once
+
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "checksec.h"
+#include "result.h"
+#include "vendor/json.hpp"
+
+namespace checksec {
+using json = nlohmann::json;
+
+void to_json(json& j, const MitigationPresence& p);
+void to_json(json& j, const MitigationReport& r);
+
+/**
+ * Serializes a scan's results, including its path.
+ */
+void to_json(json& j, const Checksec& c);
+
+std::ostream& operator<<(std::ostream& os, Checksec& self);
+
+namespace cli {
+/**
+ * How a mitigation is named in each output format.
+ */
+struct MitigationField {
+    Mitigation mitigation;
+    std::string_view key;   /**< The JSON key and CSV column name */
+    std::string_view label; /**< The (padded) text label */
+};
+
+/**
+ * Every mitigation, in output order.
+ */
+constexpr MitigationField kMitigationFields[] = {
+    {Mitigation::DynamicBase, "dynamicBase", "Dynamic Base    "},
+    {Mitigation::ASLR, "aslr", "ASLR            "},
+    {Mitigation::HighEntropyVA, "highEntropyVA", "High Entropy VA "},
+    {Mitigation::ForceIntegrity, "forceIntegrity", "Force Integrity "},
+    {Mitigation::Isolation, "isolation", "Isolation       "},
+    {Mitigation::NX, "nx", "NX              "},
+    {Mitigation::SEH, "seh", "SEH             "},
+    {Mitigation::CFG, "cfg", "CFG             "},
+    {Mitigation::RFG, "rfg", "RFG             "},
+    {Mitigation::SafeSEH, "safeSEH", "SafeSEH         "},
+    {Mitigation::GS, "gs", "GS              "},
+    {Mitigation::Authenticode, "authenticode", "Authenticode    "},
+    {Mitigation::DotNET, "dotNET", ".NET            "},
+    {Mitigation::CetCompat, "CetCompat", "CET Compatible  "},
+    {Mitigation::CFGTable, "cfgTable", "CFG Table       "},
+    {Mitigation::XFG, "xfg", "XFG             "},
+    {Mitigation::EHContinuation, "ehCont", "EH Continuation "},
+    {Mitigation::CetStrict, "cetStrict", "CET Strict Mode "},
+};
+static_assert(std::size(kMitigationFields) == kMitigationCount,
+              "every mitigation needs an output field");
+
+/**
+ * @return the name of a presence state, as it appears in every output format
+ */
+constexpr std::string_view presenceName(MitigationPresence presence) {
+    switch (presence) {
+        case MitigationPresence::Present:
+            return "Present";
+        case MitigationPresence::NotPresent:
+            return "NotPresent";
+        case MitigationPresence::NotApplicable:
+            return "NotApplicable";
+        case MitigationPresence::NotImplemented:
+            return "NotImplemented";
+        default:
+            return "Unknown";
+    }
+}
+
+/**
+ * @return the name of a scan status, as it appears in every output format
+ */
+constexpr std::string_view statusName(ScanStatus status) {
+    switch (status) {
+        case ScanStatus::Scanned:
+            return "scanned";
+        case ScanStatus::Skipped:
+            return "skipped";
+        case ScanStatus::TimedOut:
+            return "timedOut";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * @return the name of a kind of risky API, as it appears in every output format
+ */
+constexpr std::string_view apiRiskName(ApiRisk risk) {
+    switch (risk) {
+        case ApiRisk::MemoryProtection:
+            return "memoryProtection";
+        case ApiRisk::ProcessInjection:
+            return "processInjection";
+        case ApiRisk::MitigationPolicy:
+            return "mitigationPolicy";
+        case ApiRisk::DynamicResolution:
+            return "dynamicResolution";
+        case ApiRisk::ExceptionHandling:
+            return "exceptionHandling";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * @return the field for the mitigation with the given key (matched case-insensitively), or
+ *  `nullptr` if there isn't one
+ */
+const MitigationField* findMitigationField(std::string_view key);
+
+/**
+ * @return the mask of the mitigations named in `list`, by their keys (separated by commas or
+ *  whitespace, with `#` beginning a comment), or 0 if none are named
+ * @throw ChecksecError if a key doesn't name a mitigation
+ */
+CheckMask parseMitigationList(std::string_view list);
+
+/**
+ * @return the presence state with the given name (matched case-insensitively), if there is one
+ */
+std::optional<MitigationPresence> findPresence(std::string_view name);
+
+/**
+ * Serializes a detached scan result, without a path. A file that wasn't scanned is serialized
+ * as just its `status`.
+ */
+void to_json(json& j, const ScanResult& r);
+
+// NOTE: The direct formatters below append to a caller-owned buffer, which can be reused
+// across results; none of them go through a JSON value.
+
+/**
+ * Appends the human-readable summary of a result: one line per mitigation, or a single status
+ * line for a file that wasn't scanned.
+ */
+void renderText(std::string& out, const ScanResult& r);
+
+/**
+ * Appends a CSV (`,`) or TSV (`\t`) header row.
+ */
+void renderDelimitedHeader(std::string& out, char delimiter);
+
+/**
+ * Appends a CSV (`,`) or TSV (`\t`) row for a result. A file that wasn't scanned has its status
+ * in place of every presence.
+ *
+ * Paths are quoted as needed for CSV, and have tabs, newlines and backslashes escaped for TSV.
+ */
+void renderDelimited(std::string& out, std::string_view path, const ScanResult& r,
+                     char delimiter);
+}  // namespace cli
+}  // namespace checksec
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "checksec.h"
+
+namespace checksec::cli {
+
+/**
+ * Whether a file was actually scanned.
+ */
+enum class ScanStatus : std::uint8_t {
+    Scanned,  /**< The file was scanned, and its results are complete */
+    Skipped,  /**< The file was larger than the size limit, and wasn't read at all */
+    TimedOut, /**< The file's scan ran past its deadline, and was abandoned */
+};
+
+/**
+ * Everything needed to render a scan's output, detached from the image it came from.
+ */
+struct ScanResult {
+    MitigationSummary summary;
+    std::optional<AuthenticodeDigest> authenticodeDigest;
+    std::uint16_t targetMachine = 0;
+    bool is64Bit = false;
+
+    // Only scanned when asked for; see Checksec::gsInstrumentation.
+    std::optional<GSInstrumentation> gsInstrumentation;
+
+    // Likewise; see Checksec::riskyImports.
+    std::optional<std::vector<ImportFinding>> riskyImports;
+
+    // Files that weren't scanned have nothing else to report.
+    ScanStatus status = ScanStatus::Scanned;
+
+    static ScanResult from(const Checksec& checksec) {
+        return {checksec.summary(), checksec.authenticodeDigest(), checksec.targetMachine(),
+                checksec.is64Bit(), std::nullopt, std::nullopt};
+    }
+
+    static ScanResult from(const DetachedResult& detached) {
+        return {detached.summary, detached.authenticodeDigest(), detached.targetMachine,
+                detached.is64Bit, std::nullopt, std::nullopt};
+    }
+
+    static ScanResult unscanned(ScanStatus status) {
+        ScanResult result;
+        result.status = status;
+        return result;
+    }
+
+    /**
+     * Reports the mitigations outside of `checks` as \ref MitigationPresence::NotImplemented,
+     * as if only `checks` had been run.
+     */
+    void restrict(CheckMask checks) {
+        for (std::size_t i = 0; i < kMitigationCount; ++i) {
+            auto mitigation = static_cast<Mitigation>(i);
+            if (!(checks & checkMask(mitigation))) {
+                summary.set(mitigation, MitigationPresence::NotImplemented);
+            }
+        }
+        if (!(checks & checkMask(Mitigation::Authenticode))) {
+            authenticodeDigest.reset();
+        }
+    }
+};
+
+}  // namespace checksec::cli
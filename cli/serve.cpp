@@ -0,0 +1,289 @@
+#include "serve.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+
+namespace checksec::cli {
+
+int serve(const std::string&, const ServeHandler&) {
+    std::cerr << "Err: --serve requires Unix domain sockets, which aren't supported here\n";
+    return 1;
+}
+
+}  // namespace checksec::cli
+
+#else
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "vendor/json.hpp"
+
+namespace checksec::cli {
+
+namespace {
+// NOTE: Requests are single paths, so anything longer than this is a misbehaving client.
+constexpr std::size_t kMaxRequestSize = 64 * 1024;
+constexpr std::size_t kMaxPassedFds = 16;
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) { stopRequested = 1; }
+
+/**
+ * A file descriptor passed by a client, mapped for the duration of a request. Takes ownership
+ * of the descriptor, which is closed even if it can't be mapped.
+ */
+class PassedFile {
+   public:
+    explicit PassedFile(int fd) : fd_(fd) {
+        struct stat st;
+        if (::fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+            ::close(fd_);
+            throw std::runtime_error("passed descriptor isn't a non-empty regular file");
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (map == MAP_FAILED) {
+            ::close(fd_);
+            throw std::runtime_error("couldn't map passed descriptor");
+        }
+        data_ = static_cast<const std::uint8_t*>(map);
+    }
+
+    ~PassedFile() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<std::uint8_t*>(data_), size_);
+        }
+        ::close(fd_);
+    }
+
+    // can't make copies of PassedFile
+    PassedFile(const PassedFile&) = delete;
+    PassedFile& operator=(const PassedFile&) = delete;
+
+    const std::uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+   private:
+    int fd_;
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+std::string reply(std::string line, std::deque<int>& fds, const ServeHandler& handler) {
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+
+    ServeRequest request;
+    try {
+        if (line == "fd" || line.rfind("fd ", 0) == 0) {
+            request.path = line.size() > 3 ? line.substr(3) : "";
+            if (fds.empty()) {
+                throw std::runtime_error("no file descriptor was passed with the request");
+            }
+            // NOTE: Each descriptor belongs to exactly one request, even one that it fails.
+            int fd = fds.front();
+            fds.pop_front();
+            PassedFile file(fd);
+            request.data = file.data();
+            request.size = file.size();
+            return handler(request);
+        }
+
+        request.path = std::move(line);
+        return handler(request);
+    } catch (std::exception& error) {
+        return nlohmann::json{{"path", request.path}, {"error", error.what()}}.dump();
+    }
+}
+
+bool writeAll(int fd, const std::string& data) {
+    std::size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        written += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+void serveClient(int client, const ServeHandler& handler) {
+    std::string pending;
+    std::deque<int> fds;
+    char data[16 * 1024];
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxPassedFds)];
+
+    for (;;) {
+        iovec iov{data, sizeof(data)};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t n = ::recvmsg(client, &msg, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+            std::size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (std::size_t i = 0; i < count; ++i) {
+                int fd;
+                std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+                fds.push_back(fd);
+            }
+        }
+
+        // NOTE: Descriptors that didn't fit were discarded by the kernel, so later requests
+        // could no longer be matched with theirs; the connection can't continue. The ones that
+        // did arrive are closed below.
+        if (msg.msg_flags & MSG_CTRUNC) {
+            std::cerr << "Warn: client passed more than " << kMaxPassedFds
+                      << " descriptors at once; closing its connection\n";
+            break;
+        }
+
+        // NOTE: Replies to every complete request in a read go out in a single write, which
+        // keeps pipelined clients cheap.
+        pending.append(data, static_cast<std::size_t>(n));
+        std::string replies;
+        std::size_t start = 0;
+        for (std::size_t end; (end = pending.find('\n', start)) != std::string::npos;
+             start = end + 1) {
+            replies += reply(pending.substr(start, end - start), fds, handler);
+            replies += '\n';
+        }
+        pending.erase(0, start);
+
+        if (!writeAll(client, replies) || pending.size() > kMaxRequestSize) {
+            break;
+        }
+    }
+
+    for (int fd : fds) {
+        ::close(fd);
+    }
+}
+}  // namespace
+
+int serve(const std::string& socketPath, const ServeHandler& handler) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Err: socket path is too long: " << socketPath << "\n";
+        return 1;
+    }
+    std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        std::cerr << "Err: couldn't create socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    // Remove a stale socket left behind by a previous server, but never anything else.
+    struct stat st;
+    if (::lstat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        ::unlink(socketPath.c_str());
+    }
+
+    if (::bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(server, SOMAXCONN) != 0) {
+        std::cerr << "Err: couldn't listen on " << socketPath << ": " << std::strerror(errno)
+                  << "\n";
+        ::close(server);
+        return 1;
+    }
+
+    // NOTE: The stop signals interrupt accept() (no SA_RESTART), and are blocked in client
+    // threads so that they're always delivered to the accepting one.
+    struct sigaction action {};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    sigset_t stopSignals, previous;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+
+    std::mutex mutex;
+    std::condition_variable done;
+    std::set<int> clients;
+
+    while (!stopRequested) {
+        int client = ::accept(server, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cerr << "Err: accept failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            clients.insert(client);
+        }
+
+        ::pthread_sigmask(SIG_BLOCK, &stopSignals, &previous);
+        std::thread([&, client]() {
+            serveClient(client, handler);
+
+            // NOTE: Closed under the lock, so that the descriptor can't be reused by a new
+            // client while it's still in the set.
+            std::lock_guard<std::mutex> lock(mutex);
+            clients.erase(client);
+            ::close(client);
+            done.notify_all();
+        }).detach();
+        ::pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    }
+
+    ::close(server);
+    ::unlink(socketPath.c_str());
+
+    // Wake up any clients blocked on a read, and wait for them to finish.
+    std::unique_lock<std::mutex> lock(mutex);
+    for (int client : clients) {
+        ::shutdown(client, SHUT_RDWR);
+    }
+    done.wait(lock, [&]() { return clients.empty(); });
+
+    return 0;
+}
+
+}  // namespace checksec::cli
+
+#endif
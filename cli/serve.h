@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace checksec::cli {
+
+/**
+ * A single scan request received by the server.
+ */
+struct ServeRequest {
+    /**
+     * The path to scan or, when `data` is set, a label for the passed file.
+     */
+    std::string path;
+
+    /**
+     * The contents of a file passed by descriptor, mapped read-only, or `nullptr` when the
+     * request is for a path.
+     */
+    const std::uint8_t* data = nullptr;
+    std::size_t size = 0;
+};
+
+/**
+ * Renders the reply for a request. Exceptions are turned into error replies.
+ */
+using ServeHandler = std::function<std::string(const ServeRequest&)>;
+
+/**
+ * Serves scan requests on a Unix domain socket until interrupted.
+ *
+ * The protocol is line-based: each request is a single line, answered by a single line of
+ * JSON, in order. A request is either a path to scan, or `fd <label>` to scan a file
+ * descriptor passed alongside it (via `SCM_RIGHTS`). Clients may keep their connection open
+ * for any number of requests, and each connection is served concurrently with the others.
+ *
+ * @return the process exit status
+ */
+int serve(const std::string& socketPath, const ServeHandler& handler);
+
+}  // namespace checksec::cli
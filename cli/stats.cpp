@@ -0,0 +1,246 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+namespace checksec::cli {
+
+namespace {
+// The name of each phase, in Phase order.
+constexpr const char* kPhaseNames[kPhaseCount] = {
+    "io",           "parse",    "loadConfig", "debugDirectories",
+    "authenticode", "codeScan", "imports",    "serialize",
+};
+
+std::string formatDuration(std::uint64_t nanoseconds) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1);
+    if (nanoseconds < 1000) {
+        os << nanoseconds << " ns";
+    } else if (nanoseconds < 1000 * 1000) {
+        os << nanoseconds / 1e3 << " us";
+    } else if (nanoseconds < 1000 * 1000 * 1000) {
+        os << nanoseconds / 1e6 << " ms";
+    } else {
+        os << nanoseconds / 1e9 << " s";
+    }
+    return os.str();
+}
+
+std::string formatBytes(std::uint64_t bytes) {
+    constexpr const char* kUnits[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = static_cast<double>(bytes);
+    std::size_t unit = 0;
+    while (value >= 1024 && unit + 1 < std::size(kUnits)) {
+        value /= 1024;
+        ++unit;
+    }
+
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << value << ' ' << kUnits[unit];
+    return os.str();
+}
+
+std::size_t log2(std::uint64_t n) {
+    std::size_t e = 0;
+    while (n >> (e + 1)) {
+        ++e;
+    }
+    return e;
+}
+}  // namespace
+
+ScanStats::ScanStats(std::size_t slowest)
+    : start_(std::chrono::steady_clock::now()), slowest_(slowest) {}
+
+std::size_t ScanStats::bucket(std::uint64_t nanoseconds) {
+    if (nanoseconds < 16) {
+        return nanoseconds;
+    }
+
+    std::size_t e = log2(nanoseconds);
+    std::size_t sub = (nanoseconds >> (e - 3)) & (kSubBuckets - 1);
+    return 16 + (e - 4) * kSubBuckets + sub;
+}
+
+std::uint64_t ScanStats::bucketEnd(std::size_t bucket) {
+    if (bucket < 16) {
+        return bucket + 1;
+    }
+
+    std::size_t e = (bucket - 16) / kSubBuckets + 4;
+    std::uint64_t sub = (bucket - 16) % kSubBuckets;
+    return (kSubBuckets + sub + 1) << (e - 3);
+}
+
+std::uint64_t ScanStats::percentile(const Histogram& histogram, double fraction) {
+    std::uint64_t total = 0;
+    for (auto count : histogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // NOTE: Reports the end of the bucket containing the percentile, i.e. errs high.
+    auto rank = static_cast<std::uint64_t>(fraction * (total - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        if ((seen += histogram[i]) >= rank) {
+            return bucketEnd(i);
+        }
+    }
+    return bucketEnd(kBuckets - 1);
+}
+
+void ScanStats::record(const std::string& path, const PhaseTimings& timings,
+                       std::uint64_t nanoseconds, bool cached, ScanStatus status) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++files_;
+    cached_ += cached;
+    skipped_ += status == ScanStatus::Skipped;
+    timedOut_ += status == ScanStatus::TimedOut;
+
+    for (std::size_t i = 0; i < kPhaseCount; ++i) {
+        totals_.nanoseconds[i] += timings.nanoseconds[i];
+        if (timings.nanoseconds[i] != 0) {
+            ++phaseHistograms_[i][bucket(timings.nanoseconds[i])];
+        }
+    }
+    totals_.bytesRead += timings.bytesRead;
+    ++fileHistogram_[bucket(nanoseconds)];
+    maxFile_ = std::max(maxFile_, nanoseconds);
+
+    if (slowest_ == 0) {
+        return;
+    }
+    auto slower = std::greater<std::pair<std::uint64_t, std::string>>();
+    if (slowestHeap_.size() < slowest_) {
+        slowestHeap_.emplace_back(nanoseconds, path);
+        std::push_heap(slowestHeap_.begin(), slowestHeap_.end(), slower);
+    } else if (nanoseconds > slowestHeap_.front().first) {
+        std::pop_heap(slowestHeap_.begin(), slowestHeap_.end(), slower);
+        slowestHeap_.back() = {nanoseconds, path};
+        std::push_heap(slowestHeap_.begin(), slowestHeap_.end(), slower);
+    }
+}
+
+double ScanStats::elapsedSeconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+}
+
+std::vector<std::pair<std::uint64_t, std::string>> ScanStats::slowestFiles() const {
+    auto files = slowestHeap_;
+    std::sort(files.begin(), files.end(), std::greater<>());
+    return files;
+}
+
+void ScanStats::print(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double elapsed = elapsedSeconds();
+
+    os << "Scanned " << files_ << " files (" << cached_ << " from cache";
+    if (skipped_ != 0 || timedOut_ != 0) {
+        os << ", " << skipped_ << " skipped, " << timedOut_ << " timed out";
+    }
+    os << ") in " << std::fixed
+       << std::setprecision(3) << elapsed << " s: " << std::setprecision(1)
+       << (elapsed > 0 ? files_ / elapsed : 0) << " files/sec, "
+       << formatBytes(totals_.bytesRead) << " read\n";
+    os << "Per-file latency: p50 " << formatDuration(percentile(fileHistogram_, 0.5)) << ", p99 "
+       << formatDuration(percentile(fileHistogram_, 0.99)) << ", max "
+       << formatDuration(maxFile_) << "\n\n";
+
+    os << std::left << std::setw(18) << "Phase" << std::right << std::setw(12) << "total"
+       << std::setw(12) << "p50" << std::setw(12) << "p99" << "\n";
+    for (std::size_t i = 0; i < kPhaseCount; ++i) {
+        os << std::left << std::setw(18) << kPhaseNames[i] << std::right << std::setw(12)
+           << formatDuration(totals_.nanoseconds[i]) << std::setw(12)
+           << formatDuration(percentile(phaseHistograms_[i], 0.5)) << std::setw(12)
+           << formatDuration(percentile(phaseHistograms_[i], 0.99)) << "\n";
+    }
+
+    // NOTE: The fine buckets are folded into powers of two for display.
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> rows;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        if (fileHistogram_[i] == 0) {
+            continue;
+        }
+        std::uint64_t end = std::uint64_t(1) << (log2(bucketEnd(i) - 1) + 1);
+        if (rows.empty() || rows.back().first != end) {
+            rows.emplace_back(end, 0);
+        }
+        rows.back().second += fileHistogram_[i];
+    }
+    if (!rows.empty()) {
+        std::uint64_t widest = 0;
+        for (const auto& row : rows) {
+            widest = std::max(widest, row.second);
+        }
+
+        os << "\nPer-file latency histogram:\n";
+        for (const auto& [end, count] : rows) {
+            auto width = static_cast<std::size_t>(40 * count / widest);
+            os << "  < " << std::setw(9) << formatDuration(end) << " |" << std::left
+               << std::setw(40) << std::string(width, '#') << std::right << "| " << count
+               << "\n";
+        }
+    }
+
+    auto slowest = slowestFiles();
+    if (!slowest.empty()) {
+        os << "\nSlowest files:\n";
+        for (const auto& [nanoseconds, path] : slowest) {
+            os << "  " << std::setw(9) << formatDuration(nanoseconds) << "  " << path << "\n";
+        }
+    }
+}
+
+nlohmann::json ScanStats::toJson() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double elapsed = elapsedSeconds();
+
+    auto phases = nlohmann::json::object();
+    for (std::size_t i = 0; i < kPhaseCount; ++i) {
+        phases[kPhaseNames[i]] = {
+            {"totalNs", totals_.nanoseconds[i]},
+            {"p50Ns", percentile(phaseHistograms_[i], 0.5)},
+            {"p99Ns", percentile(phaseHistograms_[i], 0.99)},
+        };
+    }
+
+    auto histogram = nlohmann::json::array();
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        if (fileHistogram_[i] != 0) {
+            histogram.push_back({{"lessThanNs", bucketEnd(i)}, {"count", fileHistogram_[i]}});
+        }
+    }
+
+    auto slowest = nlohmann::json::array();
+    for (const auto& [nanoseconds, path] : slowestFiles()) {
+        slowest.push_back({{"path", path}, {"ns", nanoseconds}});
+    }
+
+    return {
+        {"files", files_},
+        {"cached", cached_},
+        {"skipped", skipped_},
+        {"timedOut", timedOut_},
+        {"elapsedSeconds", elapsed},
+        {"filesPerSecond", elapsed > 0 ? files_ / elapsed : 0},
+        {"bytesRead", totals_.bytesRead},
+        {"latency",
+         {
+             {"p50Ns", percentile(fileHistogram_, 0.5)},
+             {"p99Ns", percentile(fileHistogram_, 0.99)},
+             {"maxNs", maxFile_},
+             {"histogram", histogram},
+         }},
+        {"phases", phases},
+        {"slowest", slowest},
+    };
+}
+
+}  // namespace checksec::cli
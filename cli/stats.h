@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "checksec.h"
+#include "result.h"
+#include "vendor/json.hpp"
+
+namespace checksec::cli {
+
+/**
+ * Aggregates per-file phase timings over a scan.
+ *
+ * Recording is thread-safe, and cheap enough to happen once per file from every worker.
+ */
+class ScanStats {
+   public:
+    /**
+     * @param slowest the number of slowest files to keep track of
+     */
+    explicit ScanStats(std::size_t slowest = 10);
+
+    /**
+     * Records a scanned file.
+     *
+     * @param path the file's path
+     * @param timings the time spent on each phase of the file's scan
+     * @param nanoseconds the total time spent on the file
+     * @param cached whether the file's results came from a cache rather than a scan
+     * @param status whether the file was scanned, skipped or timed out
+     */
+    void record(const std::string& path, const PhaseTimings& timings, std::uint64_t nanoseconds,
+                bool cached, ScanStatus status = ScanStatus::Scanned);
+
+    /**
+     * Writes a human-readable summary, including a per-file latency histogram.
+     */
+    void print(std::ostream& os) const;
+
+    /**
+     * @return the summary as JSON
+     */
+    nlohmann::json toJson() const;
+
+   private:
+    // Log-linear buckets of nanoseconds: each power of two is split into 8 linear sub-buckets,
+    // which keeps percentiles within ~12% without storing every duration.
+    static constexpr std::size_t kSubBuckets = 8;
+    static constexpr std::size_t kBuckets = 16 + 60 * kSubBuckets;
+    using Histogram = std::array<std::uint64_t, kBuckets>;
+
+    static std::size_t bucket(std::uint64_t nanoseconds);
+    static std::uint64_t bucketEnd(std::size_t bucket);
+    static std::uint64_t percentile(const Histogram& histogram, double fraction);
+    double elapsedSeconds() const;
+    std::vector<std::pair<std::uint64_t, std::string>> slowestFiles() const;
+
+    std::chrono::steady_clock::time_point start_;
+    std::size_t slowest_;
+
+    mutable std::mutex mutex_;
+    std::uint64_t files_ = 0;
+    std::uint64_t cached_ = 0;
+    std::uint64_t skipped_ = 0;
+    std::uint64_t timedOut_ = 0;
+    PhaseTimings totals_;
+    std::array<Histogram, kPhaseCount> phaseHistograms_{};
+    Histogram fileHistogram_{};
+    std::uint64_t maxFile_ = 0;
+
+    // A min-heap of the slowest files seen so far.
+    std::vector<std::pair<std::uint64_t, std::string>> slowestHeap_;
+};
+
+}  // namespace checksec::cli
@@ -0,0 +1,363 @@
+#include "store.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "render.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace checksec::cli {
+
+namespace {
+constexpr char kMagic[8] = {'W', 'C', 'S', 'S', 'T', 'O', 'R', 'E'};
+constexpr std::uint32_t kVersion = 1;
+
+// NOTE: The header is followed by `rows + 1` path offsets, the path bytes (padded to a
+// multiple of 8), and then one column of `(rows + 31) / 32` words per mitigation, in enum order.
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint16_t mitigationCount;
+    std::uint16_t reserved;
+    std::uint64_t rows;
+    std::uint64_t pathBytes;
+};
+
+// The low bit of every row's two.
+constexpr std::uint64_t kLowBits = 0x5555555555555555ULL;
+
+std::uint64_t padded(std::uint64_t size) { return (size + 7) & ~std::uint64_t(7); }
+
+unsigned popcount(std::uint64_t n) {
+#ifdef _MSC_VER
+    return static_cast<unsigned>(__popcnt64(n));
+#else
+    return static_cast<unsigned>(__builtin_popcountll(n));
+#endif
+}
+
+[[noreturn]] void invalid(const std::string& message) {
+    throw ChecksecError(("invalid filter: " + message).c_str());
+}
+
+/**
+ * A recursive descent parser for filters, which emits postfix ops as it goes.
+ */
+template <typename Op>
+class FilterParser {
+   public:
+    FilterParser(std::string_view filter, std::vector<Op>& ops) : filter_(filter), ops_(ops) {}
+
+    void parse() {
+        disjunction();
+        skipSpace();
+        if (pos_ != filter_.size()) {
+            invalid("unexpected '" + std::string(filter_.substr(pos_)) + "'");
+        }
+    }
+
+   private:
+    void disjunction() {
+        conjunction();
+        while (accept("||")) {
+            conjunction();
+            ops_.push_back({Op::Or, {}, {}});
+        }
+    }
+
+    void conjunction() {
+        negation();
+        while (accept("&&")) {
+            negation();
+            ops_.push_back({Op::And, {}, {}});
+        }
+    }
+
+    void negation() {
+        if (accept("!")) {
+            negation();
+            ops_.push_back({Op::Not, {}, {}});
+        } else if (accept("(")) {
+            disjunction();
+            if (!accept(")")) {
+                invalid("expected ')'");
+            }
+        } else {
+            comparison();
+        }
+    }
+
+    void comparison() {
+        auto key = word();
+        const auto* field = findMitigationField(key);
+        if (field == nullptr) {
+            invalid("unknown mitigation '" + std::string(key) + "'");
+        }
+
+        bool negated = accept("!=");
+        if (!negated && !accept("=")) {
+            invalid("expected '=' or '!=' after '" + std::string(key) + "'");
+        }
+
+        auto name = word();
+        auto presence = findPresence(name);
+        if (!presence) {
+            invalid("unknown presence '" + std::string(name) + "'");
+        }
+
+        ops_.push_back({Op::Match, field->mitigation, *presence});
+        if (negated) {
+            ops_.push_back({Op::Not, {}, {}});
+        }
+    }
+
+    std::string_view word() {
+        skipSpace();
+        auto start = pos_;
+        while (pos_ < filter_.size() &&
+               (std::isalnum(static_cast<unsigned char>(filter_[pos_])) || filter_[pos_] == '_')) {
+            ++pos_;
+        }
+        if (start == pos_) {
+            invalid(pos_ == filter_.size() ? "unexpected end of filter"
+                                           : "unexpected '" + std::string(filter_.substr(pos_)) +
+                                                 "'");
+        }
+        return filter_.substr(start, pos_ - start);
+    }
+
+    bool accept(std::string_view token) {
+        skipSpace();
+        // NOTE: `!` on its own mustn't swallow the start of a `!=`.
+        if (filter_.substr(pos_, token.size()) != token ||
+            (token == "!" && filter_.substr(pos_, 2) == "!=")) {
+            return false;
+        }
+        pos_ += token.size();
+        return true;
+    }
+
+    void skipSpace() {
+        while (pos_ < filter_.size() && std::isspace(static_cast<unsigned char>(filter_[pos_]))) {
+            ++pos_;
+        }
+    }
+
+    std::string_view filter_;
+    std::vector<Op>& ops_;
+    std::size_t pos_ = 0;
+};
+}  // namespace
+
+ResultStoreWriter::ResultStoreWriter() : offsets_{0} {}
+
+void ResultStoreWriter::add(std::string_view path, const MitigationSummary& summary) {
+    std::size_t row = rows();
+    paths_.append(path);
+    offsets_.push_back(paths_.size());
+
+    if (row % 32 == 0) {
+        for (auto& column : columns_) {
+            column.push_back(0);
+        }
+    }
+    for (std::size_t i = 0; i < kMitigationCount; ++i) {
+        auto presence = summary.presence(static_cast<Mitigation>(i));
+        columns_[i].back() |= static_cast<std::uint64_t>(presence) << (2 * (row % 32));
+    }
+}
+
+bool ResultStoreWriter::write(std::ostream& os) const {
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.mitigationCount = kMitigationCount;
+    header.rows = rows();
+    header.pathBytes = paths_.size();
+
+    constexpr char kPadding[8] = {};
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(offsets_.data()),
+             offsets_.size() * sizeof(std::uint64_t));
+    os.write(paths_.data(), paths_.size());
+    os.write(kPadding, padded(paths_.size()) - paths_.size());
+    for (const auto& column : columns_) {
+        os.write(reinterpret_cast<const char*>(column.data()),
+                 column.size() * sizeof(std::uint64_t));
+    }
+    return os.flush().good();
+}
+
+ResultStore::ResultStore(const std::string& path) {
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw ChecksecError(("couldn't open result store " + path).c_str());
+    }
+    contents_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    const std::uint8_t* data = contents_.data();
+    std::size_t size = contents_.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw ChecksecError(("couldn't open result store " + path).c_str());
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            mapped_ = static_cast<const std::uint8_t*>(map);
+            mappedSize_ = static_cast<std::size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+    const std::uint8_t* data = mapped_;
+    std::size_t size = mappedSize_;
+#endif
+
+    // NOTE: Every section is checked against the file's size up front, so that nothing
+    // needs to be bounds-checked once the store is being queried.
+    Header header{};
+    if (size >= sizeof(header)) {
+        std::memcpy(&header, data, sizeof(header));
+    }
+    bool valid = size >= sizeof(header) &&
+                 std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+                 header.version == kVersion && header.mitigationCount == kMitigationCount &&
+                 header.rows < size / sizeof(std::uint64_t) && header.pathBytes <= size;
+    std::uint64_t words = (header.rows + 31) / 32;
+    std::uint64_t columnsAt = sizeof(Header) + (header.rows + 1) * sizeof(std::uint64_t) +
+                              padded(header.pathBytes);
+    valid = valid && columnsAt <= size &&
+            (size - columnsAt) / sizeof(std::uint64_t) / kMitigationCount >= words;
+    if (valid) {
+        offsets_ = reinterpret_cast<const std::uint64_t*>(data + sizeof(Header));
+        valid = offsets_[0] == 0 && offsets_[header.rows] == header.pathBytes &&
+                std::is_sorted(offsets_, offsets_ + header.rows + 1);
+    }
+    if (!valid) {
+#ifndef _WIN32
+        if (mapped_ != nullptr) {
+            ::munmap(const_cast<std::uint8_t*>(mapped_), mappedSize_);
+        }
+#endif
+        throw ChecksecError((path + " isn't a valid result store").c_str());
+    }
+
+    rows_ = static_cast<std::size_t>(header.rows);
+    paths_ = reinterpret_cast<const char*>(offsets_ + rows_ + 1);
+    columns_ = reinterpret_cast<const std::uint64_t*>(data + columnsAt);
+}
+
+ResultStore::~ResultStore() {
+#ifndef _WIN32
+    if (mapped_ != nullptr) {
+        ::munmap(const_cast<std::uint8_t*>(mapped_), mappedSize_);
+        mapped_ = nullptr;
+    }
+#endif
+}
+
+std::string_view ResultStore::path(std::size_t row) const {
+    return std::string_view(paths_ + offsets_[row], offsets_[row + 1] - offsets_[row]);
+}
+
+MitigationPresence ResultStore::presence(Mitigation mitigation, std::size_t row) const {
+    return static_cast<MitigationPresence>((column(mitigation)[row / 32] >> (2 * (row % 32))) &
+                                           0b11);
+}
+
+StoreQuery::StoreQuery(std::string_view filter) {
+    if (filter.find_first_not_of(" \t\r\n") == std::string_view::npos) {
+        ops_.push_back({Op::All, {}, {}});
+    } else {
+        FilterParser<Op>(filter, ops_).parse();
+    }
+
+    std::size_t depth = 0;
+    for (const auto& op : ops_) {
+        if (op.kind == Op::Match || op.kind == Op::All) {
+            depth_ = std::max(depth_, ++depth);
+        } else if (op.kind == Op::And || op.kind == Op::Or) {
+            --depth;
+        }
+    }
+}
+
+std::size_t StoreQuery::evaluate(const ResultStore& store, std::size_t start,
+                                 std::uint64_t* stack) const {
+    std::size_t n = std::min(kBlockWords, store.words() - start);
+    std::uint64_t* top = stack;
+
+    for (const auto& op : ops_) {
+        switch (op.kind) {
+            case Op::Match: {
+                // NOTE: A row matches when both of its bits equal the presence's, i.e. when
+                // both bits of the XOR are clear.
+                const std::uint64_t* column = store.column(op.mitigation) + start;
+                std::uint64_t pattern = static_cast<std::uint64_t>(op.presence) * kLowBits;
+                for (std::size_t i = 0; i < n; ++i) {
+                    std::uint64_t diff = column[i] ^ pattern;
+                    top[i] = ~(diff | (diff >> 1)) & kLowBits;
+                }
+                top += kBlockWords;
+                break;
+            }
+            case Op::All: {
+                std::fill(top, top + n, kLowBits);
+                top += kBlockWords;
+                break;
+            }
+            case Op::Not: {
+                std::uint64_t* operand = top - kBlockWords;
+                for (std::size_t i = 0; i < n; ++i) {
+                    operand[i] = ~operand[i] & kLowBits;
+                }
+                break;
+            }
+            case Op::And:
+            case Op::Or: {
+                top -= kBlockWords;
+                std::uint64_t* lhs = top - kBlockWords;
+                if (op.kind == Op::And) {
+                    for (std::size_t i = 0; i < n; ++i) {
+                        lhs[i] &= top[i];
+                    }
+                } else {
+                    for (std::size_t i = 0; i < n; ++i) {
+                        lhs[i] |= top[i];
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    // The final word may be partial. Its padding rows read as zeroes, i.e. as presence 0, so
+    // they'd match `=Present` (or, once negated, anything else) unless they're cleared here.
+    if (start + n == store.words() && store.rows() % 32 != 0) {
+        stack[n - 1] &= (std::uint64_t(1) << (2 * (store.rows() % 32))) - 1;
+    }
+    return n;
+}
+
+std::size_t StoreQuery::count(const ResultStore& store) const {
+    std::size_t matches = 0;
+    scan(store, [&](std::size_t, std::uint64_t mask) { matches += popcount(mask); });
+    return matches;
+}
+
+}  // namespace checksec::cli
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "checksec.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace checksec::cli {
+
+/**
+ * Builds a columnar result store: a dictionary of paths, plus one packed presence column per
+ * mitigation.
+ *
+ * Each column holds two bits (a MitigationPresence) per row, 32 rows to a 64-bit word, so that
+ * a filter on a mitigation can test 32 rows at a time. Rows keep the order they were added in.
+ */
+class ResultStoreWriter {
+   public:
+    ResultStoreWriter();
+
+    /**
+     * Appends a row for the file at `path`.
+     */
+    void add(std::string_view path, const MitigationSummary& summary);
+
+    /**
+     * Writes the store to `os`.
+     *
+     * @return whether the store was written successfully
+     */
+    bool write(std::ostream& os) const;
+
+    std::size_t rows() const { return offsets_.size() - 1; }
+
+   private:
+    std::string paths_;
+    std::vector<std::uint64_t> offsets_;
+    std::vector<std::uint64_t> columns_[kMitigationCount];
+};
+
+/**
+ * A read-only view of a result store written by ResultStoreWriter.
+ *
+ * The file is mapped (or, where mapping isn't available, read into memory) and validated once;
+ * after that, columns and paths are read in place.
+ */
+class ResultStore {
+   public:
+    /**
+     * @throw ChecksecError if the store can't be read, or isn't a valid store
+     */
+    explicit ResultStore(const std::string& path);
+    ~ResultStore();
+
+    // can't make copies of ResultStore
+    ResultStore(const ResultStore&) = delete;
+    ResultStore& operator=(const ResultStore&) = delete;
+
+    std::size_t rows() const { return rows_; }
+
+    /**
+     * @return the path of the given row
+     */
+    std::string_view path(std::size_t row) const;
+
+    /**
+     * @return the presence of `mitigation` in the given row
+     */
+    MitigationPresence presence(Mitigation mitigation, std::size_t row) const;
+
+    /**
+     * @return the packed presence column for `mitigation`, which is \ref words long
+     */
+    const std::uint64_t* column(Mitigation mitigation) const {
+        return columns_ + static_cast<std::size_t>(mitigation) * words();
+    }
+
+    /**
+     * @return the number of words in each column
+     */
+    std::size_t words() const { return (rows_ + 31) / 32; }
+
+   private:
+    const std::uint8_t* mapped_ = nullptr;
+    std::size_t mappedSize_ = 0;
+    std::vector<std::uint8_t> contents_;
+
+    std::size_t rows_ = 0;
+    const std::uint64_t* offsets_ = nullptr;
+    const char* paths_ = nullptr;
+    const std::uint64_t* columns_ = nullptr;
+};
+
+/**
+ * A filter over the rows of a result store.
+ *
+ * Filters compare mitigations to presences (`cfg=NotPresent`, `gs!=Present`), and combine
+ * comparisons with `&&`, `||`, `!` and parentheses. Mitigations are named by their JSON keys, and
+ * both they and presences are matched case-insensitively.
+ */
+class StoreQuery {
+   public:
+    /**
+     * @param filter the filter to parse; an empty filter matches every row
+     * @throw ChecksecError if the filter is malformed
+     */
+    explicit StoreQuery(std::string_view filter);
+
+    /**
+     * Calls `fn` with each matching row of `store`, in order.
+     *
+     * @return the number of matching rows
+     */
+    template <typename Fn>
+    std::size_t forEach(const ResultStore& store, Fn&& fn) const {
+        std::size_t matches = 0;
+        scan(store, [&](std::size_t word, std::uint64_t mask) {
+            // NOTE: Each matching row is marked by the low bit of its two.
+            for (; mask != 0; mask &= mask - 1) {
+                fn(word * 32 + countTrailingZeros(mask) / 2);
+                ++matches;
+            }
+        });
+        return matches;
+    }
+
+    /**
+     * @return the number of rows in `store` that match
+     */
+    std::size_t count(const ResultStore& store) const;
+
+   private:
+    // Filters are compiled to postfix, and evaluated over a block of words at a time.
+    struct Op {
+        enum Kind { Match, Not, And, Or, All } kind;
+        Mitigation mitigation;
+        MitigationPresence presence;
+    };
+
+    template <typename Fn>
+    void scan(const ResultStore& store, Fn&& fn) const {
+        std::vector<std::uint64_t> stack(depth_ * kBlockWords);
+        for (std::size_t start = 0; start < store.words(); start += kBlockWords) {
+            std::size_t n = evaluate(store, start, stack.data());
+            for (std::size_t i = 0; i < n; ++i) {
+                if (stack[i] != 0) {
+                    fn(start + i, stack[i]);
+                }
+            }
+        }
+    }
+
+    /**
+     * Evaluates the filter over the block of words beginning at `start`, using `stack` (which
+     * holds `depth_` blocks) as scratch space.
+     *
+     * @return the number of words evaluated, whose masks are left at the start of `stack`
+     */
+    std::size_t evaluate(const ResultStore& store, std::size_t start, std::uint64_t* stack) const;
+
+    static unsigned countTrailingZeros(std::uint64_t n) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, n);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctzll(n));
+#endif
+    }
+
+    static constexpr std::size_t kBlockWords = 256;
+
+    std::vector<Op> ops_;
+    std::size_t depth_ = 0;
+};
+
+}  // namespace checksec::cli
@@ -0,0 +1,105 @@
+#include "walk.h"
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace checksec::cli {
+
+namespace fs = std::filesystem;
+
+bool looksLikePE(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+
+    // NOTE: e_lfanew lives at the very end of the 64-byte DOS header.
+    unsigned char dos[0x40];
+    if (!file.read(reinterpret_cast<char*>(dos), sizeof(dos)) || dos[0] != 'M' || dos[1] != 'Z') {
+        return false;
+    }
+
+    std::uint32_t lfanew = dos[0x3c] | (dos[0x3d] << 8) | (dos[0x3e] << 16) |
+                           (static_cast<std::uint32_t>(dos[0x3f]) << 24);
+    char signature[4];
+    if (!file.seekg(lfanew) || !file.read(signature, sizeof(signature))) {
+        return false;
+    }
+
+    return signature[0] == 'P' && signature[1] == 'E' && signature[2] == '\0' &&
+           signature[3] == '\0';
+}
+
+DirectoryWalker::DirectoryWalker(const std::string& root) {
+    std::error_code ec;
+    it_ = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        std::cerr << "Warn: couldn't open " << root << ": " << ec.message() << "\n";
+    }
+}
+
+std::optional<std::string> DirectoryWalker::next() {
+    std::error_code ec;
+    while (it_ != fs::recursive_directory_iterator()) {
+        fs::directory_entry entry = *it_;
+        it_.increment(ec);
+        if (ec) {
+            std::cerr << "Warn: " << ec.message() << "\n";
+            ec.clear();
+        }
+
+        // NOTE: Symlinks are followed for files but not for directories, which keeps
+        // the walk from looping.
+        if (entry.is_regular_file(ec)) {
+            return entry.path().string();
+        }
+    }
+
+    return std::nullopt;
+}
+
+PathListReader::PathListReader(const std::string& source, char delimiter)
+    : in_(&std::cin), delimiter_(delimiter) {
+    if (source != "-") {
+        file_.open(source);
+        in_ = &file_;
+        if (!file_) {
+            std::cerr << "Warn: couldn't open " << source << "\n";
+        }
+    }
+}
+
+std::optional<std::string> PathListReader::next() {
+    std::string path;
+    while (std::getline(*in_, path, delimiter_)) {
+        // NOTE: Tolerate CRLF-terminated lists.
+        if (delimiter_ == '\n' && !path.empty() && path.back() == '\r') {
+            path.pop_back();
+        }
+        if (!path.empty()) {
+            return path;
+        }
+    }
+
+    return std::nullopt;
+}
+
+bool PathListReader::ready() const {
+    // NOTE: Files never wait on a producer, and neither does anything already buffered.
+    if (in_ == &file_ || in_->rdbuf()->in_avail() > 0) {
+        return true;
+    }
+
+#ifdef _WIN32
+    return false;
+#else
+    pollfd stdinPoll{STDIN_FILENO, POLLIN, 0};
+    return ::poll(&stdinPoll, 1, 0) > 0;
+#endif
+}
+
+}  // namespace checksec::cli
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <optional>
+#include <string>
+
+namespace checksec::cli {
+
+/**
+ * Performs a cheap check for the `MZ` and `PE\0\0` signatures at the start of the file.
+ *
+ * This reads at most a few dozen bytes, which is enough to weed out the vast majority of
+ * non-PE files before paying for a full load.
+ *
+ * @return true if the file at `path` looks like a PE, false otherwise
+ */
+bool looksLikePE(const std::string& path);
+
+/**
+ * Lazily walks a directory tree, yielding regular files as they're found.
+ *
+ * Unreadable directories are skipped rather than aborting the walk.
+ */
+class DirectoryWalker {
+   public:
+    explicit DirectoryWalker(const std::string& root);
+
+    /**
+     * @return the path of the next regular file in the tree, or `std::nullopt` once the walk
+     *  is complete
+     */
+    std::optional<std::string> next();
+
+   private:
+    std::filesystem::recursive_directory_iterator it_;
+};
+
+/**
+ * Lazily reads a list of paths from a file or standard input.
+ *
+ * Paths are yielded as soon as each one has been read in full, so that a consumer can start on
+ * them while whatever is producing the list is still running.
+ */
+class PathListReader {
+   public:
+    /**
+     * @param source the file to read paths from, or `-` for standard input
+     * @param delimiter the character separating paths, e.g. `'\n'` or `'\0'`
+     */
+    PathListReader(const std::string& source, char delimiter);
+
+    /**
+     * @return the next path in the list, or `std::nullopt` once the list is exhausted
+     */
+    std::optional<std::string> next();
+
+    /**
+     * @return false if \ref next might have to wait for the list's producer, e.g. on an empty
+     *  pipe; true if the next read can go ahead without waiting
+     *
+     * @note A partially written path can still make \ref next wait for the rest of it.
+     */
+    bool ready() const;
+
+   private:
+    std::ifstream file_;
+    std::istream* in_;
+    char delimiter_;
+};
+
+}  // namespace checksec::cli
@@ -0,0 +1,123 @@
+#include "checksec.h"
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+namespace checksec {
+
+namespace impl {
+namespace {
+// NOTE: Only APIs that are imported by name are worth listing here; anything resolved at
+// runtime shows up as GetProcAddress (or its loader equivalents) instead.
+constexpr ApiEntry kRiskyApis[] = {
+    {"VirtualProtect", ApiRisk::MemoryProtection},
+    {"VirtualProtectFromApp", ApiRisk::MemoryProtection},
+    {"NtProtectVirtualMemory", ApiRisk::MemoryProtection},
+    {"ZwProtectVirtualMemory", ApiRisk::MemoryProtection},
+    {"VirtualAlloc2", ApiRisk::MemoryProtection},
+    {"VirtualAllocFromApp", ApiRisk::MemoryProtection},
+    {"FlushInstructionCache", ApiRisk::MemoryProtection},
+
+    {"WriteProcessMemory", ApiRisk::ProcessInjection},
+    {"NtWriteVirtualMemory", ApiRisk::ProcessInjection},
+    {"VirtualAllocEx", ApiRisk::ProcessInjection},
+    {"VirtualAllocExNuma", ApiRisk::ProcessInjection},
+    {"VirtualProtectEx", ApiRisk::ProcessInjection},
+    {"CreateRemoteThread", ApiRisk::ProcessInjection},
+    {"CreateRemoteThreadEx", ApiRisk::ProcessInjection},
+    {"NtCreateThreadEx", ApiRisk::ProcessInjection},
+    {"RtlCreateUserThread", ApiRisk::ProcessInjection},
+    {"QueueUserAPC", ApiRisk::ProcessInjection},
+    {"NtQueueApcThread", ApiRisk::ProcessInjection},
+    {"SetThreadContext", ApiRisk::ProcessInjection},
+    {"NtSetContextThread", ApiRisk::ProcessInjection},
+    {"NtMapViewOfSection", ApiRisk::ProcessInjection},
+
+    {"SetProcessDEPPolicy", ApiRisk::MitigationPolicy},
+    {"SetProcessMitigationPolicy", ApiRisk::MitigationPolicy},
+    {"SetProcessValidCallTargets", ApiRisk::MitigationPolicy},
+    {"SetProcessValidCallTargetsForMappedView", ApiRisk::MitigationPolicy},
+    {"SetProcessDynamicEHContinuationTargets", ApiRisk::MitigationPolicy},
+    {"SetProcessDynamicEnforcedCetCompatibleRanges", ApiRisk::MitigationPolicy},
+    {"NtSetInformationProcess", ApiRisk::MitigationPolicy},
+    {"ZwSetInformationProcess", ApiRisk::MitigationPolicy},
+
+    {"GetProcAddress", ApiRisk::DynamicResolution},
+    {"LoadLibraryA", ApiRisk::DynamicResolution},
+    {"LoadLibraryW", ApiRisk::DynamicResolution},
+    {"LoadLibraryExA", ApiRisk::DynamicResolution},
+    {"LoadLibraryExW", ApiRisk::DynamicResolution},
+    {"LdrLoadDll", ApiRisk::DynamicResolution},
+    {"LdrGetProcedureAddress", ApiRisk::DynamicResolution},
+
+    {"SetUnhandledExceptionFilter", ApiRisk::ExceptionHandling},
+    {"AddVectoredExceptionHandler", ApiRisk::ExceptionHandling},
+    {"AddVectoredContinueHandler", ApiRisk::ExceptionHandling},
+    {"RtlAddVectoredExceptionHandler", ApiRisk::ExceptionHandling},
+    {"RtlAddFunctionTable", ApiRisk::ExceptionHandling},
+    {"RtlAddGrowableFunctionTable", ApiRisk::ExceptionHandling},
+    {"RtlInstallFunctionTableCallback", ApiRisk::ExceptionHandling},
+};
+
+// A power of two, comfortably larger than the catalog, so that a collision-free seed turns up
+// after a handful of tries.
+constexpr std::size_t kApiSlots = 256;
+constexpr std::uint8_t kEmptySlot = 0xff;
+static_assert(std::size(kRiskyApis) < kEmptySlot, "catalog indices must fit in a slot");
+
+// FNV-1a, seeded, with a final mix so that the low bits (which pick the slot) depend on the
+// whole name.
+constexpr std::uint32_t apiHash(std::string_view name, std::uint32_t seed) {
+    std::uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (char c : name) {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6du;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+struct ApiTable {
+    std::uint32_t seed;
+    std::array<std::uint8_t, kApiSlots> slots;
+};
+
+// Tries seeds until every catalog entry hashes to a distinct slot.
+constexpr ApiTable buildApiTable() {
+    for (std::uint32_t seed = 0; seed < 10000; ++seed) {
+        ApiTable table{seed, {}};
+        for (auto& slot : table.slots) {
+            slot = kEmptySlot;
+        }
+
+        bool perfect = true;
+        for (std::size_t i = 0; i < std::size(kRiskyApis) && perfect; ++i) {
+            auto& slot = table.slots[apiHash(kRiskyApis[i].name, seed) & (kApiSlots - 1)];
+            perfect = slot == kEmptySlot;
+            slot = static_cast<std::uint8_t>(i);
+        }
+        if (perfect) {
+            return table;
+        }
+    }
+    throw std::logic_error("no perfect hash for the risky API catalog");
+}
+
+constexpr ApiTable kApiTable = buildApiTable();
+}  // namespace
+
+const ApiEntry* findRiskyApi(std::string_view name) {
+    auto index = kApiTable.slots[apiHash(name, kApiTable.seed) & (kApiSlots - 1)];
+    if (index == kEmptySlot || kRiskyApis[index].name != name) {
+        return nullptr;
+    }
+    return &kRiskyApis[index];
+}
+}  // namespace impl
+
+}  // namespace checksec
@@ -1,8 +1,18 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <pe-parse/parse.h>
 
@@ -16,6 +26,94 @@ class ChecksecError : public std::runtime_error {
     ChecksecError(const char* what) : std::runtime_error(what) {}
 };
 
+/**
+ * Raised when a scan runs past the deadline set by a ScopedDeadline, or is cancelled through it.
+ */
+class TimeoutError : public ChecksecError {
+   public:
+    explicit TimeoutError(const char* what = "Scan timed out") : ChecksecError(what) {}
+};
+
+/**
+ * Sets a deadline for the scans run on the current thread, for as long as it's in scope.
+ *
+ * Scans check the deadline cooperatively, before each phase and each read from disk, and throw
+ * TimeoutError once it has passed. A single call into pe-parse or uthenticode can't be
+ * interrupted, so a scan can still overrun its deadline by the length of one such call.
+ */
+class ScopedDeadline {
+   public:
+    explicit ScopedDeadline(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @param deadline the deadline, if the scans have one
+     * @param cancelled a flag that, once set (from any thread), abandons the scans at the same
+     *  points that a deadline would
+     */
+    ScopedDeadline(std::optional<std::chrono::steady_clock::time_point> deadline,
+                   const std::atomic<bool>& cancelled);
+    ~ScopedDeadline();
+
+    // can't make copies of ScopedDeadline
+    ScopedDeadline(const ScopedDeadline&) = delete;
+    ScopedDeadline& operator=(const ScopedDeadline&) = delete;
+
+    /**
+     * @throw TimeoutError if the current thread's deadline has passed, or its scans have been
+     *  cancelled
+     */
+    static void check();
+
+   private:
+    std::optional<std::chrono::steady_clock::time_point> previous_;
+    const std::atomic<bool>* previousCancelled_;
+};
+
+/**
+ * Controls how much of an image is read from disk.
+ */
+enum class LoadMode {
+    Full, /**< Read and parse the entire image up front */
+
+    /**
+     * Read only the image headers up front. The data directories that the selected checks need
+     * (the load config and debug directories) are read as they're parsed, and the rest of the
+     * image is read on demand, e.g. when an Authenticode check requires hashing the whole file.
+     */
+    HeadersOnly,
+};
+
+/**
+ * The phases of a scan that are timed.
+ */
+enum class Phase : std::uint8_t {
+    IO,               /**< Reading the image from disk */
+    Parse,            /**< Parsing the image with pe-parse (including `ParsePEFromFile`) */
+    LoadConfig,       /**< Reading the load config directory */
+    DebugDirectories, /**< Iterating over the debug directories */
+    Authenticode,     /**< Verifying Authenticode signatures, including hashing the image */
+    CodeScan,         /**< Scanning code for instrumentation; see Checksec::gsInstrumentation */
+    Imports,          /**< Matching imports against the catalog; see Checksec::riskyImports */
+    Serialize,        /**< Rendering results; timed by callers, not by `Checksec` itself */
+};
+
+constexpr std::size_t kPhaseCount = static_cast<std::size_t>(Phase::Serialize) + 1;
+
+/**
+ * Time spent in each phase of a scan, along with the number of bytes read from disk.
+ *
+ * Phases are timed exclusively: time spent reading the rest of the image during Authenticode
+ * verification counts towards IO, not Authenticode.
+ */
+struct PhaseTimings {
+    std::uint64_t nanoseconds[kPhaseCount] = {};
+    std::uint64_t bytesRead = 0;
+
+    std::uint64_t operator[](Phase phase) const {
+        return nanoseconds[static_cast<std::size_t>(phase)];
+    }
+};
+
 /**
  * A namespace for winchecksec's implementation internals.
  *
@@ -75,17 +173,168 @@ constexpr const char kCetDescription[] =
     "Binaries with cet compat support will use "
     "the shadow stack (if available) to mitigate ROP.";
 
+constexpr const char kCFGTableDescription[] =
+    "Binaries with a CFG function table enumerate their valid indirect call "
+    "targets, without which CFG has nothing to enforce.";
+
+constexpr const char kXFGDescription[] =
+    "Binaries with XFG enabled also check the type signature of each "
+    "indirect call's target.";
+
+constexpr const char kEHContinuationDescription[] =
+    "Binaries with EH continuation metadata restrict the targets that "
+    "exception handling can resume execution at.";
+
+constexpr const char kCetStrictDescription[] =
+    "Binaries with CET strict mode enabled always have shadow stack "
+    "violations enforced.";
+
+constexpr const char kStrippedRelocationsExplanation[] =
+    "Image has stripped relocations, making ASLR impossible.";
+
+constexpr const char kDotNETASLRExplanation[] = ".NET binaries have ASLR via the .NET runtime.";
+
+constexpr const char kDotNETNXExplanation[] = ".NET binaries have DEP via the .NET runtime.";
+
+constexpr const char kCFGRequiresASLRExplanation[] = "Control Flow Guard requires functional ASLR.";
+
+constexpr const char kShortLoadConfigRFGExplanation[] =
+    "Image load config is too short to contain RFG configuration fields.";
+
+constexpr const char kSafeSEHNotApplicableExplanation[] =
+    "The SafeSEH mitigation only applies to x86_32 binaries.";
+
+constexpr const char kShortLoadConfigSafeSEHExplanation[] =
+    "Image load config is too short to contain a SE handler table.";
+
+constexpr const char kShortLoadConfigGSExplanation[] =
+    "Image load config is too short to contain a GS security cookie.";
+
+constexpr const char kCFGTableRequiresCFGExplanation[] =
+    "A CFG function table is only enforced when CFG is enabled.";
+
+constexpr const char kShortLoadConfigCFGTableExplanation[] =
+    "Image load config is too short to contain a CFG function table.";
+
+constexpr const char kCFGTableOutOfBoundsExplanation[] =
+    "The CFG function table lies outside of the image.";
+
+constexpr const char kXFGRequiresCFGExplanation[] = "XFG requires Control Flow Guard.";
+
+constexpr const char kShortLoadConfigXFGExplanation[] =
+    "Image load config is too short to contain XFG configuration fields.";
+
+constexpr const char kEHContinuationNotApplicableExplanation[] =
+    "EH continuation metadata only applies to 64-bit binaries.";
+
+constexpr const char kShortLoadConfigEHContinuationExplanation[] =
+    "Image load config is too short to contain an EH continuation table.";
+
+constexpr const char kEHContinuationOutOfBoundsExplanation[] =
+    "The EH continuation table lies outside of the image.";
+
+constexpr const char kCetStrictRequiresCetExplanation[] =
+    "CET strict mode requires CET compatibility.";
+
+/**
+ * A short byte pattern, matched under a mask: the pattern matches at a position when every
+ * byte there satisfies `(byte & mask[i]) == value[i]`.
+ */
+struct BytePattern {
+    static constexpr std::size_t kMaxSize = 16;
+
+    std::uint8_t value[kMaxSize];
+    std::uint8_t mask[kMaxSize];
+
+    /**
+     * The pattern's length, which must be at least 2.
+     */
+    std::size_t size;
+};
+
+/**
+ * The ways a PatternScanner can find candidate positions.
+ */
+enum class ScanBackend {
+    Auto,   /**< The widest backend that the CPU supports */
+    Scalar, /**< One position at a time */
+    SSE2,   /**< 16 positions at a time (x86_64 only) */
+    AVX2,   /**< 32 positions at a time (x86_64 CPUs with AVX2 only) */
+};
+
+/**
+ * Finds every occurrence of a small set of masked byte patterns, in a single pass over a
+ * buffer.
+ *
+ * The first two bytes of every pattern are tested at 32 (AVX2) or 16 (SSE2) positions at a
+ * time, and only the positions where some pattern's first two bytes match are verified in full.
+ * On x86_64, AVX2 is used where the CPU supports it and SSE2 otherwise; other architectures
+ * fall back to a scalar loop.
+ */
+class PatternScanner {
+   public:
+    struct Match {
+        std::size_t offset;  /**< The offset of the match within the buffer */
+        std::size_t pattern; /**< The index of the matching pattern */
+    };
+
+    /**
+     * @param backend the backend to scan with; anything other than ScanBackend::Auto is only
+     *  useful for testing each backend in turn
+     * @throw ChecksecError if `backend` isn't supported on this CPU
+     */
+    explicit PatternScanner(std::vector<BytePattern> patterns,
+                            ScanBackend backend = ScanBackend::Auto);
+
+    /**
+     * @return whether `backend` can be used on this CPU
+     */
+    static bool supports(ScanBackend backend);
+
+    /**
+     * @return the backend in use, which is never ScanBackend::Auto
+     */
+    ScanBackend backend() const { return backend_; }
+
+    /**
+     * Appends every match in `data` to `matches`, in order of offset (and then of pattern).
+     */
+    void scan(const std::uint8_t* data, std::size_t size, std::vector<Match>& matches) const;
+
+   private:
+    void verify(const std::uint8_t* data, std::size_t size, std::size_t offset,
+                std::vector<Match>& matches) const;
+
+    std::vector<BytePattern> patterns_;
+    ScanBackend backend_;
+};
+
+// NOTE: Enough to cover the DOS header, the NT headers and the section table of
+// practically every image in a single read.
+constexpr std::uint64_t kHeaderReadSize = 4096;
+
+/**
+ * A range of bytes within a file.
+ */
+struct FileRange {
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
 /**
  * A RAII wrapped for `pe-parse::parsed_pe`.
  */
 class LoadedImage {
    public:
-    explicit LoadedImage(const std::string path) {
-        if (!(pe_ = peparse::ParsePEFromFile(path.c_str()))) {
-            throw ChecksecError("Couldn't load file; corrupt or not a PE?");
-        }
-    }
-    ~LoadedImage() { peparse::DestructParsedPE(pe_); }
+    explicit LoadedImage(const std::string path, LoadMode mode = LoadMode::Full);
+
+    /**
+     * Parses an image directly from caller-owned memory, without copying it.
+     *
+     * @note The memory must outlive the `LoadedImage`.
+     */
+    LoadedImage(const std::uint8_t* data, std::size_t size);
+    ~LoadedImage();
 
     // can't make copies of LoadedImage
     LoadedImage(const LoadedImage&) = delete;
@@ -93,8 +342,84 @@ class LoadedImage {
 
     peparse::parsed_pe* get() const { return pe_; }
 
+    /**
+     * @return the mode the image is currently loaded in
+     */
+    LoadMode mode() const { return mode_; }
+
+    /**
+     * @return the image's entry for the given data directory, as it appears in the file, or an
+     *  empty entry if the image doesn't have one
+     *
+     * @note A partially loaded image hides most of its directories from pe-parse, so this is
+     *       the only way to find them.
+     */
+    peparse::data_directory directory(peparse::data_directory_kind kind) const;
+
+    /**
+     * Ensures that the given byte range of the file is present in the image buffer, reading it
+     * from disk if the image was only partially loaded.
+     *
+     * @return true if at least part of the range lies within the file, false otherwise
+     */
+    bool fetch(std::uint64_t offset, std::uint64_t size);
+
+    /**
+     * Ensures that the contents of the given data directory are present in the image buffer.
+     * Only the load config and debug directories can be fetched this way.
+     */
+    void fetchDirectory(peparse::data_directory_kind kind);
+
+    /**
+     * Finds the file offset of `size` bytes at `rva`, which must lie entirely within a single
+     * section's raw data.
+     *
+     * @return the range's offset, or std::nullopt if the range isn't backed by the file
+     */
+    std::optional<std::uint64_t> fileRange(std::uint32_t rva, std::uint64_t size) const;
+
+    /**
+     * Finds the bytes at `rva`, reading the whole of the section that contains them if the image
+     * was only partially loaded. Each section is read at most once.
+     *
+     * @return a pointer to the bytes at `rva`, and the number of bytes from there to the end of
+     *  the section's raw data, or `{nullptr, 0}` if `rva` isn't backed by the file
+     */
+    std::pair<const std::uint8_t*, std::size_t> sectionData(std::uint32_t rva);
+
+    /**
+     * Frees the image: its buffer, and pe-parse's parse of it. Only the timings survive, and
+     * \ref get returns `nullptr` afterwards.
+     */
+    void release();
+
+    /**
+     * Upgrades a partially loaded image to a full one, reading and re-parsing the entire file.
+     * Does nothing if the image is already fully loaded.
+     */
+    void loadFull();
+
+    /**
+     * @return the time spent loading (and parsing) the image so far
+     */
+    PhaseTimings& timings() { return timings_; }
+    const PhaseTimings& timings() const { return timings_; }
+
    private:
-    peparse::parsed_pe* pe_;
+    bool loadHeaders();
+    std::optional<std::uint64_t> rvaToOffset(std::uint32_t rva) const;
+
+    peparse::parsed_pe* pe_ = nullptr;
+    LoadMode mode_;
+    std::ifstream file_;
+    std::uint8_t* buffer_ = nullptr;
+    std::uint64_t size_ = 0;
+    std::uint64_t sectionTable_ = 0;
+    std::uint64_t dataDirectories_ = 0;
+    std::uint16_t numberOfSections_ = 0;
+    peparse::data_directory directories_[16] = {};
+    std::vector<bool> fetchedSections_;
+    PhaseTimings timings_;
 };
 }  // namespace impl
 
@@ -110,6 +435,247 @@ enum class MitigationPresence {
     NotImplemented, /**< Support for detecting this mitigation is not implemented */
 };
 
+/**
+ * The security mitigations that winchecksec detects.
+ */
+enum class Mitigation : std::uint8_t {
+    DynamicBase,    /**< See Checksec::isDynamicBase */
+    ASLR,           /**< See Checksec::isASLR */
+    HighEntropyVA,  /**< See Checksec::isHighEntropyVA */
+    ForceIntegrity, /**< See Checksec::isForceIntegrity */
+    Isolation,      /**< See Checksec::isIsolation */
+    NX,             /**< See Checksec::isNX */
+    SEH,            /**< See Checksec::isSEH */
+    CFG,            /**< See Checksec::isCFG */
+    RFG,            /**< See Checksec::isRFG */
+    SafeSEH,        /**< See Checksec::isSafeSEH */
+    GS,             /**< See Checksec::isGS */
+    Authenticode,   /**< See Checksec::isAuthenticode */
+    DotNET,         /**< See Checksec::isDotNET */
+    CetCompat,      /**< See Checksec::isCetCompat */
+    CFGTable,       /**< See Checksec::isCFGTable */
+    XFG,            /**< See Checksec::isXFG */
+    EHContinuation, /**< See Checksec::isEHContinuation */
+    CetStrict,      /**< See Checksec::isCetStrict */
+};
+
+/**
+ * The number of members in \ref Mitigation.
+ */
+constexpr std::size_t kMitigationCount = static_cast<std::size_t>(Mitigation::CetStrict) + 1;
+
+/**
+ * A set of checks to run, with one bit per \ref Mitigation.
+ */
+using CheckMask = std::uint32_t;
+
+/**
+ * @return the mask that selects only `mitigation`'s check
+ */
+constexpr CheckMask checkMask(Mitigation mitigation) {
+    return CheckMask{1} << static_cast<unsigned>(mitigation);
+}
+
+/**
+ * The mask that selects every check.
+ */
+constexpr CheckMask kAllChecks = (CheckMask{1} << kMitigationCount) - 1;
+
+namespace impl {
+constexpr std::string_view kDescriptions[kMitigationCount] = {
+    kDynamicBaseDescription,    kASLRDescription,   kHighEntropyVADescription,
+    kForceIntegrityDescription, kIsolationDescription, kNXDescription,
+    kSEHDescription,            kCFGDescription,    kRFGDescription,
+    kSafeSEHDescription,        kGSDescription,     kAuthenticodeDescription,
+    kDotNETDescription,         kCetDescription,    kCFGTableDescription,
+    kXFGDescription,            kEHContinuationDescription, kCetStrictDescription,
+};
+
+/**
+ * The number of distinct explanations a single mitigation can carry.
+ */
+constexpr std::size_t kMaxExplanations = 3;
+
+// The explanations for each mitigation's state. A mitigation's explanation is recorded as its
+// (1-based) index into its row, with 0 meaning no explanation.
+constexpr std::string_view kExplanations[kMitigationCount][kMaxExplanations] = {
+    /* DynamicBase */ {},
+    /* ASLR */ {kStrippedRelocationsExplanation, kDotNETASLRExplanation},
+    /* HighEntropyVA */ {},
+    /* ForceIntegrity */ {},
+    /* Isolation */ {},
+    /* NX */ {kDotNETNXExplanation},
+    /* SEH */ {},
+    /* CFG */ {kCFGRequiresASLRExplanation},
+    /* RFG */ {kShortLoadConfigRFGExplanation},
+    /* SafeSEH */ {kSafeSEHNotApplicableExplanation, kShortLoadConfigSafeSEHExplanation},
+    /* GS */ {kShortLoadConfigGSExplanation},
+    /* Authenticode */ {},
+    /* DotNET */ {},
+    /* CetCompat */ {},
+    /* CFGTable */
+    {kCFGTableRequiresCFGExplanation, kShortLoadConfigCFGTableExplanation,
+     kCFGTableOutOfBoundsExplanation},
+    /* XFG */ {kXFGRequiresCFGExplanation, kShortLoadConfigXFGExplanation},
+    /* EHContinuation */
+    {kEHContinuationNotApplicableExplanation, kShortLoadConfigEHContinuationExplanation,
+     kEHContinuationOutOfBoundsExplanation},
+    /* CetStrict */ {kCetStrictRequiresCetExplanation},
+};
+
+/**
+ * @return the code for `explanation` within `mitigation`'s row of kExplanations
+ *
+ * @note Intended for use in constant expressions, where an unknown explanation fails to compile.
+ */
+constexpr std::uint8_t explanationCode(Mitigation mitigation, std::string_view explanation) {
+    const auto& row = kExplanations[static_cast<std::size_t>(mitigation)];
+    for (std::size_t i = 0; i < kMaxExplanations; ++i) {
+        if (row[i] == explanation) {
+            return static_cast<std::uint8_t>(i + 1);
+        }
+    }
+    throw std::logic_error("unknown explanation");
+}
+}  // namespace impl
+
+/**
+ * @return a brief description of the given mitigation
+ */
+constexpr std::string_view description(Mitigation mitigation) {
+    return impl::kDescriptions[static_cast<std::size_t>(mitigation)];
+}
+
+/**
+ * The kinds of risky API that the import check looks for. An image that imports these can
+ * weaken (or work around) its own mitigations at runtime.
+ */
+enum class ApiRisk : std::uint8_t {
+    MemoryProtection,  /**< Changes memory protections, e.g. `VirtualProtect` */
+    ProcessInjection,  /**< Writes to or runs code in other processes, e.g. `WriteProcessMemory` */
+    MitigationPolicy,  /**< Changes process mitigation policies, e.g. `SetProcessDEPPolicy` */
+    DynamicResolution, /**< Resolves APIs at runtime, e.g. `GetProcAddress` */
+    ExceptionHandling, /**< Installs exception handlers, e.g. `AddVectoredExceptionHandler` */
+};
+
+/**
+ * The number of members in \ref ApiRisk.
+ */
+constexpr std::size_t kApiRiskCount = static_cast<std::size_t>(ApiRisk::ExceptionHandling) + 1;
+
+namespace impl {
+constexpr std::string_view kApiRiskDescriptions[kApiRiskCount] = {
+    "Changing memory protections at runtime can undo DEP, e.g. by making data executable.",
+    "Writing to, or creating threads in, other processes is a common code injection technique.",
+    "Process mitigation policies (including DEP, and CFG's valid call targets) can be relaxed "
+    "at runtime.",
+    "APIs resolved at runtime don't appear in the import table, and can hide any of the others.",
+    "Process-wide exception handlers can intercept faults before SEH and EH continuation "
+    "metadata are consulted.",
+};
+
+/**
+ * An entry in the catalog of risky APIs.
+ */
+struct ApiEntry {
+    std::string_view name;
+    ApiRisk risk;
+};
+
+/**
+ * Looks an imported name up in the catalog of risky APIs.
+ *
+ * The catalog is a perfect hash table that's built at compile time, so each lookup hashes the
+ * name once and compares it against at most one entry, without allocating.
+ *
+ * @return the name's catalog entry, or `nullptr` if it isn't in the catalog
+ */
+const ApiEntry* findRiskyApi(std::string_view name);
+}  // namespace impl
+
+/**
+ * @return a brief description of the given kind of risky API
+ */
+constexpr std::string_view description(ApiRisk risk) {
+    return impl::kApiRiskDescriptions[static_cast<std::size_t>(risk)];
+}
+
+/**
+ * A compact record of every mitigation's state, packed two bits per mitigation, along with
+ * a (likewise packed) code for each mitigation's explanation.
+ *
+ * Summaries are trivially copyable and cheap to compare, which makes them suitable for storing
+ * or aggregating results in bulk.
+ */
+class MitigationSummary {
+   public:
+    constexpr MitigationSummary() = default;
+
+    /**
+     * Reconstitutes a summary from its packed representation.
+     *
+     * @param bits the value of \ref bits on the original summary
+     * @param explanationBits the value of \ref explanationBits on the original summary
+     */
+    constexpr MitigationSummary(std::uint64_t bits, std::uint64_t explanationBits)
+        : bits_(bits), explanationBits_(explanationBits) {}
+
+    /**
+     * @return the state of the given mitigation
+     */
+    constexpr MitigationPresence presence(Mitigation mitigation) const {
+        return static_cast<MitigationPresence>((bits_ >> shift(mitigation)) & 0b11);
+    }
+
+    /**
+     * @return the explanation for the given mitigation's state, if it has one
+     */
+    constexpr std::optional<std::string_view> explanation(Mitigation mitigation) const {
+        auto code = (explanationBits_ >> shift(mitigation)) & 0b11;
+        if (code == 0) {
+            return std::nullopt;
+        }
+        return impl::kExplanations[static_cast<std::size_t>(mitigation)][code - 1];
+    }
+
+    /**
+     * Records the state of the given mitigation.
+     *
+     * @param explanation the explanation's code, as returned by impl::explanationCode
+     */
+    constexpr void set(Mitigation mitigation, MitigationPresence presence,
+                       std::uint8_t explanation = 0) {
+        bits_ &= ~(std::uint64_t{0b11} << shift(mitigation));
+        bits_ |= static_cast<std::uint64_t>(presence) << shift(mitigation);
+        explanationBits_ &= ~(std::uint64_t{0b11} << shift(mitigation));
+        explanationBits_ |= static_cast<std::uint64_t>(explanation & 0b11) << shift(mitigation);
+    }
+
+    /**
+     * @return the packed presence of every mitigation
+     */
+    constexpr std::uint64_t bits() const { return bits_; }
+
+    /**
+     * @return the packed explanation codes of every mitigation
+     */
+    constexpr std::uint64_t explanationBits() const { return explanationBits_; }
+
+    constexpr bool operator==(const MitigationSummary& other) const {
+        return bits_ == other.bits_ && explanationBits_ == other.explanationBits_;
+    }
+    constexpr bool operator!=(const MitigationSummary& other) const { return !(*this == other); }
+
+   private:
+    static constexpr unsigned shift(Mitigation mitigation) {
+        return static_cast<unsigned>(mitigation) * 2;
+    }
+
+    // NOTE: Every mitigation starts out as NotImplemented (0b11), without an explanation.
+    std::uint64_t bits_ = ~std::uint64_t{0};
+    std::uint64_t explanationBits_ = 0;
+};
+
 /**
  * Represents a "report" on a particular security mitigation.
  */
@@ -122,12 +688,12 @@ struct MitigationReport {
     /**
      * A brief description of the mitigation.
      */
-    std::string description;
+    std::string_view description;
 
     /**
      * An optional explanation of the mitigation's detection (or non-detection).
      */
-    std::optional<std::string> explanation;
+    std::optional<std::string_view> explanation;
 
     /**
      * @return true if `presence` is \ref MitigationPresence::Present, false otherwise
@@ -135,18 +701,227 @@ struct MitigationReport {
     operator bool() const { return presence == MitigationPresence::Present; }
 };
 
+/**
+ * The image digest embedded in an Authenticode signature.
+ */
+struct AuthenticodeDigest {
+    /**
+     * The digest algorithm, e.g. `"SHA256"`.
+     */
+    std::string algorithm;
+
+    /**
+     * The digest itself, as a hex string.
+     */
+    std::string digest;
+};
+
+/**
+ * The result of scanning an image's code for stack cookie (`/GS`) instrumentation.
+ */
+struct GSInstrumentation {
+    /**
+     * The number of functions found: the entries in the exception directory for x86_64 images,
+     * and the frame pointer prologues (`push ebp; mov ebp, esp`) for x86_32 ones.
+     */
+    std::uint32_t functions = 0;
+
+    /**
+     * The number of those functions that load the security cookie into a stack-keyed
+     * prologue, e.g. `mov rax, [__security_cookie]; xor rax, rsp`.
+     */
+    std::uint32_t instrumented = 0;
+
+    /**
+     * The number of epilogues that check the cookie, i.e. un-key it and call
+     * `__security_check_cookie`. The check function is taken to be the most common target of
+     * calls that directly follow an un-keying `xor`.
+     */
+    std::uint32_t checks = 0;
+
+    /**
+     * @return the fraction of functions that are instrumented, or 0 if there are none
+     */
+    double fraction() const { return functions == 0 ? 0 : double(instrumented) / functions; }
+};
+
+/**
+ * An import that matches the catalog of risky APIs.
+ */
+struct ImportFinding {
+    /**
+     * The name of the DLL that the API is imported from, as it appears in the image.
+     */
+    std::string module;
+
+    /**
+     * The API's name, as it appears in the catalog.
+     */
+    std::string_view function;
+
+    ApiRisk risk;
+
+    /**
+     * Whether the API is delay-loaded, i.e. only resolved on its first call.
+     */
+    bool delayLoaded = false;
+};
+
+/**
+ * A read-only view of one of the load config's guard tables, such as the CFG function table,
+ * over the image's own bytes.
+ *
+ * Each entry is an RVA, followed by `stride() - 4` bytes of metadata (per the
+ * `IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK` bits of the load config's GuardFlags). Views are
+ * only made over tables that lie entirely within the image, so no entry needs to be
+ * bounds-checked on its own.
+ */
+class GuardTable {
+   public:
+    GuardTable() = default;
+
+    /**
+     * @param data the table's first entry
+     * @param size the number of entries
+     * @param stride the size of each entry, in bytes (at least 4)
+     */
+    GuardTable(const std::uint8_t* data, std::size_t size, std::size_t stride)
+        : data_(data), size_(size), stride_(stride) {}
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    std::size_t stride() const { return stride_; }
+
+    /**
+     * @return the RVA of the `index`th entry, which must be less than \ref size
+     */
+    std::uint32_t rva(std::size_t index) const {
+        const std::uint8_t* entry = data_ + index * stride_;
+        return entry[0] | (entry[1] << 8) | (entry[2] << 16) |
+               (static_cast<std::uint32_t>(entry[3]) << 24);
+    }
+
+    /**
+     * @return the first metadata byte of the `index`th entry (e.g. the
+     *  `IMAGE_GUARD_FLAG_FID_*` flags), or 0 if entries don't carry any
+     */
+    std::uint8_t flags(std::size_t index) const {
+        return stride_ > 4 ? data_[index * stride_ + 4] : 0;
+    }
+
+   private:
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t stride_ = 4;
+};
+
+/**
+ * The results of a scan, detached from the image they came from; see Checksec::detach.
+ *
+ * Detached results are trivially copyable, so they can be queued or stored in bulk without
+ * keeping any part of the image alive.
+ */
+struct DetachedResult {
+    MitigationSummary summary;
+    std::uint16_t targetMachine = 0;
+    bool is64Bit = false;
+    PhaseTimings timings;
+
+    /**
+     * The Authenticode digest's algorithm and (hex) digest, as NUL-terminated strings, or empty
+     * strings if the image has no verified digest. The digest has room for SHA-512.
+     */
+    char digestAlgorithm[8] = {};
+    char digest[129] = {};
+
+    /**
+     * @return the Authenticode digest, as Checksec::authenticodeDigest returned it
+     */
+    std::optional<AuthenticodeDigest> authenticodeDigest() const {
+        if (digest[0] == '\0') {
+            return std::nullopt;
+        }
+        return AuthenticodeDigest{digestAlgorithm, digest};
+    }
+};
+static_assert(std::is_trivially_copyable_v<DetachedResult>,
+              "detached results must be trivially copyable");
+
 /**
  * Represents the main winchecksec interface.
  */
 class Checksec {
    public:
-    Checksec(std::string filepath);
+    /**
+     * @param filepath the path to the PE to check
+     * @param mode how much of the PE to read up front
+     * @param checks the checks to run; mitigations that aren't selected are reported as
+     *  \ref MitigationPresence::NotImplemented, and data directories are only parsed when a
+     *  selected check needs them
+     */
+    Checksec(std::string filepath, LoadMode mode = LoadMode::Full, CheckMask checks = kAllChecks);
+
+    /**
+     * Checks a PE that's already in memory, without copying it or touching the filesystem.
+     *
+     * @param data the PE's bytes, which must remain valid for the lifetime of the `Checksec`
+     *  (Authenticode verification reads them lazily)
+     * @param size the size of `data`, in bytes
+     * @param label an optional name for the PE, returned by `filepath()`
+     * @param checks the checks to run, as for the path-based constructor
+     */
+    Checksec(const std::uint8_t* data, std::size_t size, std::string label = "",
+             CheckMask checks = kAllChecks);
 
     /**
-     * @return a string reference for the filepath that this `Checksec` instance was created with
+     * Predicts the ranges of a file, past its first \ref impl::kHeaderReadSize bytes, that a
+     * \ref LoadMode::HeadersOnly scan with the given checks will read, so that they can be read
+     * ahead of the scan itself.
+     *
+     * @param headers the start of the file: its first `impl::kHeaderReadSize` bytes, or all of
+     *  it if it's smaller
+     * @param size the number of bytes in `headers`
+     * @param fileSize the size of the whole file
+     * @return the ranges, in no particular order, or nothing if `headers` aren't a PE's. A
+     *  section table that runs past `headers` is returned on its own, since the directories
+     *  can't be located without it.
+     *
+     * @note Tables that are only found by reading the load config (e.g. the CFG function table)
+     *       aren't predicted.
+     */
+    static std::vector<impl::FileRange> plannedReads(const std::uint8_t* headers,
+                                                     std::size_t size, std::uint64_t fileSize,
+                                                     CheckMask checks = kAllChecks);
+
+    /**
+     * @return a string reference for the filepath (or label) that this `Checksec` instance was
+     *  created with
      */
     const std::string filepath() const { return filepath_; }
 
+    /**
+     * @return the machine type from the COFF file header, e.g. `IMAGE_FILE_MACHINE_AMD64`
+     */
+    std::uint16_t targetMachine() const { return targetMachine_; }
+
+    /**
+     * @return true if the image is a PE32+ (64-bit) image, false if it's a PE32 one
+     */
+    bool is64Bit() const { return is64Bit_; }
+
+    /**
+     * @return a MitigationSummary with the state of every mitigation
+     *
+     * @note Every mitigation is evaluated once, when the `Checksec` is constructed; this
+     *       only adds the (cached) Authenticode verification.
+     */
+    const MitigationSummary& summary() const;
+
+    /**
+     * @return a MitigationReport for the given mitigation
+     */
+    const MitigationReport report(Mitigation mitigation) const;
+
     /**
      * @return a MitigationReport indicating whether the program can be loaded from a dynamic base
      *  address (i.e. `/DYNAMICBASE`)
@@ -198,9 +973,39 @@ class Checksec {
      *
      * @note See the [`uthenticode`](https://trailofbits.github.io/uthenticode/index.html)
      *       documentation for the details of this check
+     *
+     * @note The (expensive) verification is performed on the first call and cached, so this
+     *       method is not safe to call from multiple threads on the same instance.
      */
     const MitigationReport isAuthenticode() const;
 
+    /**
+     * @return the image digest from the program's Authenticode signature, if the program is
+     *  signed and the digest matches the image
+     *
+     * @note This shares its (cached) work with \ref isAuthenticode, so the signed image's hash
+     *       comes for free once the signature has been checked.
+     */
+    const std::optional<AuthenticodeDigest>& authenticodeDigest() const;
+
+    /**
+     * Evaluates every check that's still pending (i.e. Authenticode), then frees the image.
+     *
+     * @return the results of every check
+     *
+     * @note Afterwards, only results that have already been evaluated remain available: the
+     *       mitigations and the Authenticode digest, along with the code scan and the risky
+     *       imports if they were asked for beforehand. The guard tables are empty.
+     */
+    DetachedResult detach();
+
+    /**
+     * @return the time spent on each phase of this check so far
+     *
+     * @note Authenticode time only shows up once the signature has been checked.
+     */
+    const PhaseTimings& timings() const { return loadedImage_.timings(); }
+
     /**
      * @return a MitigationReport indicating whether the program supports Return Flow Guard
      */
@@ -219,10 +1024,36 @@ class Checksec {
      *       the instrumentation that actually checks that address. Every modern version of
      *       MSVCRT has stack cookies enabled in some form, so this can result in false
      *       positives if your application code links to MSVCRT but doesn't enable its own
-     *       stack cookies.
+     *       stack cookies. See \ref gsInstrumentation for a check of the instrumentation.
      */
     const MitigationReport isGS() const;
 
+    /**
+     * Scans the program's executable sections for stack cookie instrumentation, and reports
+     * how many of its functions have it.
+     *
+     * @return the functions found and instrumented, or std::nullopt if the GS check isn't
+     *  selected or the program isn't an x86_32 or x86_64 one
+     *
+     * @note This reads the entire image, and scans all of its code, so it's far more expensive
+     *       than any other check. The scan is performed on the first call and cached, so this
+     *       method is not safe to call from multiple threads on the same instance.
+     */
+    std::optional<GSInstrumentation> gsInstrumentation() const;
+
+    /**
+     * Matches every API that the program imports by name, directly or through its delay-load
+     * imports, against a catalog of risky and mitigation-weakening APIs (e.g. `VirtualProtect`,
+     * `WriteProcessMemory` and `SetProcessDEPPolicy`).
+     *
+     * @return the imports found in the catalog, in the order of the import tables
+     *
+     * @note A partially loaded image only reads the sections that hold its import tables. The
+     *       tables are walked on the first call and cached, so this method is not safe to call
+     *       from multiple threads on the same instance.
+     */
+    const std::vector<ImportFinding>& riskyImports() const;
+
     /**
      * @return a MitigationReport indicating whether this program runs in the .NET environment
      */
@@ -233,10 +1064,64 @@ class Checksec {
      */
     const MitigationReport isCetCompat() const;
 
+    /**
+     * @return a MitigationReport indicating whether the program has CFG enabled **and** a
+     *  non-empty function table (within the image) for it to enforce
+     */
+    const MitigationReport isCFGTable() const;
+
+    /**
+     * @return a MitigationReport indicating whether the program supports eXtended Flow Guard
+     *  (i.e. `/guard:xfg`)
+     */
+    const MitigationReport isXFG() const;
+
+    /**
+     * @return a MitigationReport indicating whether the program has a (non-empty) EH
+     *  continuation table (i.e. `/guard:ehcont`)
+     */
+    const MitigationReport isEHContinuation() const;
+
+    /**
+     * @return a MitigationReport indicating whether the program is compiled with CET support
+     *  in strict mode (i.e. `/CETCOMPAT:STRICT`)
+     */
+    const MitigationReport isCetStrict() const;
+
+    /**
+     * @return the CFG function table: the RVAs of every valid indirect call target, or an empty
+     *  view if the program has no table (or its table lies outside of the image)
+     *
+     * @note Tables are viewed in place rather than copied, and a partially loaded image only
+     *       reads its table on the first call, so this method is not safe to call from multiple
+     *       threads on the same instance. Views are valid for the lifetime of the `Checksec`.
+     */
+    GuardTable guardCFFunctionTable() const;
+
+    /**
+     * @return the EH continuation table: the RVAs of every valid exception handling
+     *  continuation target, or an empty view, as for \ref guardCFFunctionTable
+     */
+    GuardTable guardEHContinuationTable() const;
+
    private:
-    impl::LoadedImage loadedImage_;
+    void parse();
+    template <typename LoadConfig>
+    void parseLoadConfig();
+    void parseDebugDirectories();
+    std::optional<std::uint64_t> locateGuardTable(std::uint64_t va, std::uint64_t count) const;
+    GuardTable guardTable(std::optional<std::uint64_t> offset, std::uint64_t count) const;
+    void evaluate();
+    void verifyAuthenticode() const;
+    void scanImportThunks(std::string_view module, std::uint32_t thunks, std::uint64_t base,
+                          bool delayLoaded) const;
+    std::string_view importName(std::uint32_t rva) const;
+
+    mutable impl::LoadedImage loadedImage_;
     std::string filepath_;
+    CheckMask checks_ = kAllChecks;
     std::uint16_t targetMachine_ = 0;
+    bool is64Bit_ = false;
     std::uint16_t imageCharacteristics_ = 0;
     std::uint16_t dllCharacteristics_ = 0;
     std::uint32_t loadConfigSize_ = 0;
@@ -244,8 +1129,22 @@ class Checksec {
     std::uint64_t loadConfigSEHandlerTable_ = 0;
     std::uint64_t loadConfigSEHandlerCount_ = 0;
     std::uint64_t loadConfigSecurityCookie_ = 0;
+    std::uint64_t loadConfigGuardCFFunctionCount_ = 0;
+    std::uint64_t loadConfigGuardEHContinuationCount_ = 0;
+    std::uint64_t loadConfigGuardXFGCheckFunctionPointer_ = 0;
+    std::optional<std::uint64_t> guardCFFunctionTableOffset_;
+    std::optional<std::uint64_t> guardEHContinuationTableOffset_;
+    std::uint64_t imageBase_ = 0;
     peparse::data_directory clrConfig_ = {0};
+    peparse::data_directory securityDir_ = {0};
+    mutable bool gsScanned_ = false;
+    mutable std::optional<GSInstrumentation> gsInstrumentation_;
+    mutable bool importsScanned_ = false;
+    mutable std::vector<ImportFinding> riskyImports_;
+    mutable bool authenticodeVerified_ = false;
+    mutable std::optional<AuthenticodeDigest> authenticodeDigest_;
     std::uint16_t extendedDllCharacteristics_ = 0;
+    mutable MitigationSummary summary_;
 };
 
 }  // namespace checksec
@@ -1,141 +1,759 @@
 #include "checksec.h"
+#include "cli/aggregate.h"
+#include "cli/budget.h"
+#include "cli/cache.h"
+#include "cli/dedup.h"
+#include "cli/output.h"
+#include "cli/policy.h"
+#include "cli/pool.h"
+#include "cli/readahead.h"
+#include "cli/render.h"
+#include "cli/result.h"
+#include "cli/serve.h"
+#include "cli/stats.h"
+#include "cli/store.h"
+#include "cli/walk.h"
 #include "vendor/argh.h"
 #include "vendor/json.hpp"
 
-using json = nlohmann::json;
-
-namespace checksec {
-void to_json(json& j, const MitigationPresence& p) {
-    switch (p) {
-        default: {
-            j = "Unknown";
-            break;
-        }
-        case MitigationPresence::Present: {
-            j = "Present";
-            break;
-        }
-        case MitigationPresence::NotPresent: {
-            j = "NotPresent";
-            break;
-        }
-        case MitigationPresence::NotApplicable: {
-            j = "NotApplicable";
-            break;
-        }
-        case MitigationPresence::NotImplemented: {
-            j = "NotImplemented";
-            break;
-        }
-    }
-}
-
-void to_json(json& j, const MitigationReport& r) {
-    j = {
-        {"presence", r.presence},
-        {"description", r.description},
-    };
-
-    if (r.explanation) {
-        j["explanation"] = r.explanation.value();
-    }
-}
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
 
-void to_json(json& j, const Checksec& c) {
-    j = {
-        {
-            "mitigations",
-            {
-                {"dynamicBase", c.isDynamicBase()},
-                {"aslr", c.isASLR()},
-                {"highEntropyVA", c.isHighEntropyVA()},
-                {"forceIntegrity", c.isForceIntegrity()},
-                {"isolation", c.isIsolation()},
-                {"nx", c.isNX()},
-                {"seh", c.isSEH()},
-                {"cfg", c.isCFG()},
-                {"rfg", c.isRFG()},
-                {"safeSEH", c.isSafeSEH()},
-                {"gs", c.isGS()},
-                {"authenticode", c.isAuthenticode()},
-                {"dotNET", c.isDotNET()},
-                {"CetCompat", c.isCetCompat()},
-            },
-        },
-        {"path", c.filepath()},
-    };
-}
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
-std::ostream& operator<<(std::ostream& os, Checksec& self) {
-    json j(self);
-    os << "Dynamic Base    : " << j["mitigations"]["dynamicBase"]["presence"] << "\n";
-    os << "ASLR            : " << j["mitigations"]["aslr"]["presence"] << "\n";
-    os << "High Entropy VA : " << j["mitigations"]["highEntropyVA"]["presence"] << "\n";
-    os << "Force Integrity : " << j["mitigations"]["forceIntegrity"]["presence"] << "\n";
-    os << "Isolation       : " << j["mitigations"]["isolation"]["presence"] << "\n";
-    os << "NX              : " << j["mitigations"]["nx"]["presence"] << "\n";
-    os << "SEH             : " << j["mitigations"]["seh"]["presence"] << "\n";
-    os << "CFG             : " << j["mitigations"]["cfg"]["presence"] << "\n";
-    os << "RFG             : " << j["mitigations"]["rfg"]["presence"] << "\n";
-    os << "SafeSEH         : " << j["mitigations"]["safeSEH"]["presence"] << "\n";
-    os << "GS              : " << j["mitigations"]["gs"]["presence"] << "\n";
-    os << "Authenticode    : " << j["mitigations"]["authenticode"]["presence"] << "\n";
-    os << ".NET            : " << j["mitigations"]["dotNET"]["presence"] << "\n";
-    os << "CET Compatible  : " << j["mitigations"]["CetCompat"]["presence"] << "\n";
-    return os;
-}
-}  // namespace checksec
+using json = nlohmann::json;
 
 void usage(char* argv[]) {
-    std::cerr << "Syntax : " << argv[0] << " [--json] <file [file ...]>"
+    std::cerr << "Syntax : " << argv[0]
+              << " [--json] [--output text|json|jsonl|csv|tsv|store] [--jobs N] "
+                 "[--recursive <dir>] [--files-from <file|-> [-0]] <file [file ...]>"
+              << "\n";
+    std::cerr << "       " << argv[0] << " query [--count] <store> [filter]"
               << "\n";
     std::cerr << "Example: " << argv[0] << " --json doom2.exe"
               << "\n";
     std::cerr << "  -j/--json will output JSON to stdout"
               << "\n";
+    std::cerr << "  -o/--output jsonl will output one JSON object per line, as soon as each file "
+                 "is scanned"
+              << "\n";
+    std::cerr << "  -o/--output csv|tsv will output a header row, then one row of presences per "
+                 "file"
+              << "\n";
+    std::cerr << "  -o/--output store will output a columnar result store, for use with query"
+              << "\n";
+    std::cerr << "  --jobs N will scan with N parallel workers (default: one per CPU)"
+              << "\n";
+    std::cerr << "  -r/--recursive <dir> will scan every PE found under <dir>"
+              << "\n";
+    std::cerr << "  --files-from <file|-> will also scan the paths listed in <file> (or stdin), "
+                 "one per line"
+              << "\n";
+    std::cerr << "  -0/--null will read NUL-delimited paths with --files-from, e.g. from find "
+                 "-print0"
+              << "\n";
+    std::cerr << "  --serve <socket> will serve scan requests on a Unix domain socket until "
+                 "interrupted"
+              << "\n";
+    std::cerr << "  --checks <mitigation,...> will only check for the named mitigations, e.g. "
+                 "nx,dynamicBase; the rest are reported as NotImplemented"
+              << "\n";
+    std::cerr << "  --aggregate will print counts of each mitigation's presence by machine type, "
+                 "instead of per-file results"
+              << "\n";
+    std::cerr << "  --group-by-dir N will also break --aggregate counts down by each file's first "
+                 "N directories"
+              << "\n";
+    std::cerr << "  --require <mitigation,...> will only check that every file has the named "
+                 "mitigations, e.g. cfg,gs,nx,aslr"
+              << "\n";
+    std::cerr << "  --policy <file> will read the required mitigations from <file>"
+              << "\n";
+    std::cerr << "  --fail-fast will stop scanning at the first file that violates --require or "
+                 "--policy"
+              << "\n";
+    std::cerr << "  --stats will print per-phase timings, latency percentiles and the slowest "
+                 "files to stderr"
+              << "\n";
+    std::cerr << "  --stats-json <file> will write the same statistics to <file> as JSON"
+              << "\n";
+    std::cerr << "  --memory-budget <size> will wait to load more files while the ones being "
+                 "scanned add up to <size> bytes, e.g. 512M"
+              << "\n";
+    std::cerr << "  --max-file-size <size> will skip files larger than <size> bytes, e.g. 256M, "
+                 "and report them as skipped"
+              << "\n";
+    std::cerr << "  --per-file-timeout <duration> will abandon scans that take longer than "
+                 "<duration>, e.g. 500ms or 30s, and report them as timed out"
+              << "\n";
+    std::cerr << "  --readahead N will read up to N upcoming files' headers at once, ahead of "
+                 "their scans, and have the kernel prefetch the rest of what they need (Linux "
+                 "only)"
+              << "\n";
+    std::cerr << "  --cache <file> will reuse results for files that haven't changed since <file>"
+              << " was last written"
+              << "\n";
+    std::cerr << "  --cache-hash will also compare file contents when using the cache"
+              << "\n";
+    std::cerr << "  --dedup will scan files with identical contents only once, and mark the "
+                 "others as duplicates"
+              << "\n";
+    std::cerr << "  --deep-gs will also scan each file's code for stack cookie instrumentation, "
+                 "and report the fraction of its functions that have it"
+              << "\n";
+    std::cerr << "  --imports will also report each file's imports of risky APIs, e.g. "
+                 "VirtualProtect or SetProcessDEPPolicy"
+              << "\n";
+    std::cerr << "  query will print the path of each file in <store> matching [filter], e.g. "
+                 "'cfg=NotPresent && authenticode=Present'"
+              << "\n";
+    std::cerr << "  query --count will print the number of matching files instead"
+              << "\n";
+}
+
+/**
+ * The supported output formats.
+ */
+enum class Format {
+    Text,  /**< Human-readable text, one block per file */
+    JSON,  /**< A single JSON array, written once the scan completes */
+    JSONL, /**< JSON Lines: one compact JSON object per file, written as results arrive */
+    CSV,   /**< Comma-separated presences, one row per file after a header row */
+    TSV,   /**< Tab-separated presences, one row per file after a header row */
+    Store, /**< A columnar result store, written once the scan completes */
+};
+
+/**
+ * A file waiting to be scanned.
+ */
+struct Candidate {
+    std::string path;
+
+    /**
+     * Whether the file was found by walking a directory rather than named explicitly. Discovered
+     * files that aren't PEs are skipped quietly instead of failing the scan.
+     */
+    bool discovered;
+};
+
+/**
+ * Runs `winchecksec query`.
+ */
+int query(const argh::parser& cmdl, char* argv[]) {
+    if (cmdl.size() < 3 || cmdl.size() > 4) {
+        usage(argv);
+        return 1;
+    }
+
+    try {
+        checksec::cli::ResultStore store(cmdl[2]);
+        checksec::cli::StoreQuery query(cmdl.size() == 4 ? cmdl[3] : "");
+        if (cmdl["--count"]) {
+            std::cout << query.count(store) << '\n';
+            return 0;
+        }
+
+        checksec::cli::ChunkedWriter out(std::cout);
+        std::string line;
+        query.forEach(store, [&](std::size_t row) {
+            line.assign(store.path(row)).append(1, '\n');
+            out.write(line);
+        });
+        out.flush();
+    } catch (checksec::ChecksecError& error) {
+        std::cerr << error.what() << '\n';
+        return 2;
+    }
+    return 0;
 }
 
 void version() { std::cerr << "Winchecksec version " << WINCHECKSEC_VERSION << "\n"; }
 
 int main(int argc, char* argv[]) {
-    argh::parser cmdl(argc, argv);
+    argh::parser cmdl;
+    cmdl.add_params({"--jobs", "-r", "--recursive", "-o", "--output", "--cache", "--files-from",
+                     "--serve", "--stats-json", "--group-by-dir", "--require", "--policy",
+                     "--checks", "--memory-budget", "--readahead", "--max-file-size",
+                     "--per-file-timeout"});
+    cmdl.parse(argc, argv);
 
     if (cmdl[{"-V", "--version"}]) {
         version();
         return 0;
     }
 
-    bool json = cmdl[{"-j", "--json"}];
-    if (cmdl.size() < 2) {
+    if (cmdl.size() > 1 && cmdl[1] == "query") {
+        return query(cmdl, argv);
+    }
+
+    Format format = cmdl[{"-j", "--json"}] ? Format::JSON : Format::Text;
+    if (auto output = cmdl({"-o", "--output"})) {
+        if (output.str() == "text") {
+            format = Format::Text;
+        } else if (output.str() == "json") {
+            format = Format::JSON;
+        } else if (output.str() == "jsonl") {
+            format = Format::JSONL;
+        } else if (output.str() == "csv") {
+            format = Format::CSV;
+        } else if (output.str() == "tsv") {
+            format = Format::TSV;
+        } else if (output.str() == "store") {
+            format = Format::Store;
+        } else {
+            usage(argv);
+            return 1;
+        }
+    }
+
+    if (auto socket = cmdl("--serve")) {
+        return checksec::cli::serve(socket.str(), [](const checksec::cli::ServeRequest& request) {
+            json j;
+            if (request.data) {
+                j = checksec::Checksec(request.data, request.size, request.path);
+            } else {
+                j = checksec::Checksec(request.path, checksec::LoadMode::HeadersOnly);
+            }
+            return j.dump();
+        });
+    }
+
+    std::optional<checksec::cli::DirectoryWalker> walker;
+    if (auto root = cmdl({"-r", "--recursive"})) {
+        walker.emplace(root.str());
+    }
+
+    // NOTE: argh treats `-0` as a (negative) number rather than a flag, so we pick it out of
+    // the positional arguments ourselves. Similarly, it treats the `-` in `--files-from -` as a
+    // flag of its own rather than a parameter.
+    // TODO(ww): https://github.com/adishavit/argh/issues/57
+    std::vector<std::string> paths;
+    bool nullDelimited = cmdl["--null"];
+    for (auto arg = std::next(cmdl.begin()); arg != cmdl.end(); ++arg) {
+        if (*arg == "-0") {
+            nullDelimited = true;
+        } else {
+            paths.push_back(*arg);
+        }
+    }
+
+    std::optional<checksec::cli::PathListReader> reader;
+    if (auto source = cmdl("--files-from")) {
+        reader.emplace(source.str(), nullDelimited ? '\0' : '\n');
+    } else if (cmdl["--files-from"] && cmdl["-"]) {
+        reader.emplace("-", nullDelimited ? '\0' : '\n');
+    }
+
+    if (paths.empty() && !walker && !reader) {
         usage(argv);
         return 1;
     }
 
-    // TODO(ww): https://github.com/adishavit/argh/issues/57
-    auto results = json::array();
-    for (auto path = std::next(cmdl.begin()); path != cmdl.end(); ++path) {
+    std::size_t jobs = std::thread::hardware_concurrency();
+    if (cmdl("--jobs") && !(cmdl("--jobs") >> jobs)) {
+        usage(argv);
+        return 1;
+    }
+
+    // NOTE: Declared before the pool, so that the workers are joined before the cache is
+    // closed.
+    std::optional<checksec::cli::ResultCache> cache;
+    if (auto path = cmdl("--cache")) {
+        cache.emplace(path.str(), cmdl["--cache-hash"]);
+    }
+
+    std::optional<checksec::cli::ContentIndex> dedup;
+    if (cmdl["--dedup"]) {
+        dedup.emplace();
+    }
+
+    std::optional<checksec::cli::Aggregate> aggregate;
+    if (cmdl["--aggregate"]) {
+        std::size_t groupDepth = 0;
+        if (cmdl("--group-by-dir") && !(cmdl("--group-by-dir") >> groupDepth)) {
+            usage(argv);
+            return 1;
+        }
+        aggregate.emplace(groupDepth);
+    }
+
+    // NOTE: With a policy, each file is reduced to a violation line (or nothing), which
+    // replaces the normal output.
+    std::optional<checksec::cli::Policy> policy;
+    try {
+        if (auto required = cmdl("--require")) {
+            policy.emplace(required.str());
+        } else if (auto path = cmdl("--policy")) {
+            policy.emplace(checksec::cli::Policy::load(path.str()));
+        }
+    } catch (checksec::ChecksecError& error) {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+    if (policy && aggregate) {
+        usage(argv);
+        return 1;
+    }
+    bool failFast = policy && cmdl["--fail-fast"];
+
+    // NOTE: A policy only needs its own checks run.
+    checksec::CheckMask checks = checksec::kAllChecks;
+    try {
+        if (auto selected = cmdl("--checks")) {
+            if ((checks = checksec::cli::parseMitigationList(selected.str())) == 0) {
+                usage(argv);
+                return 1;
+            }
+        } else if (policy) {
+            checks = policy->checks();
+        }
+    } catch (checksec::ChecksecError& error) {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+    if (policy) {
+        checks |= policy->checks();
+    }
+
+    std::optional<checksec::cli::ByteBudget> budget;
+    if (auto size = cmdl("--memory-budget")) {
+        auto limit = checksec::cli::parseByteSize(size.str());
+        if (!limit || *limit == 0) {
+            usage(argv);
+            return 1;
+        }
+        budget.emplace(*limit);
+    }
+
+    std::optional<std::uint64_t> maxFileSize;
+    if (auto size = cmdl("--max-file-size")) {
+        if (!(maxFileSize = checksec::cli::parseByteSize(size.str()))) {
+            usage(argv);
+            return 1;
+        }
+    }
+
+    std::optional<std::chrono::milliseconds> timeout;
+    if (auto duration = cmdl("--per-file-timeout")) {
+        if (!(timeout = checksec::cli::parseDuration(duration.str())) || timeout->count() == 0) {
+            usage(argv);
+            return 1;
+        }
+    }
+
+    std::optional<checksec::cli::ScanStats> stats;
+    auto statsJson = cmdl("--stats-json");
+    if (cmdl["--stats"] || statsJson) {
+        stats.emplace();
+    }
+
+    // NOTE: Workers run the checks and render each result; the main thread only submits
+    // paths and emits results in their original order. The window bounds how far scanning can run
+    // ahead of output when an early file is slow. Discovered files that turn out not to be PEs
+    // come back as empty results and are dropped.
+    // NOTE: Only the JSON formats need a JSON value; the others are rendered directly. When
+    // aggregating, results are only counted, and nothing is rendered at all.
+    // NOTE: Duplicates are still rendered (and counted) under their own paths; only the
+    // text and JSON formats say which file they duplicate.
+    auto render = [format, &aggregate, &policy](const std::string& path,
+                                                const checksec::cli::ScanResult& result,
+                                                const std::string& duplicateOf) {
+        std::string out;
+        // NOTE: Files that weren't scanned can't be counted, or stored, so they're only
+        // mentioned on stderr. A policy can't be met by a file that wasn't checked against it.
+        bool scanned = result.status == checksec::cli::ScanStatus::Scanned;
+        if (!scanned && (aggregate || (format == Format::Store && !policy))) {
+            std::cerr << "Warn: " << path << ": " << checksec::cli::statusName(result.status)
+                      << "\n";
+            return out;
+        }
+        if (aggregate) {
+            aggregate->record(path, result);
+            return out;
+        }
+        if (policy) {
+            if (!scanned) {
+                out.append(path).append(": ").append(checksec::cli::statusName(result.status));
+                out.append(1, '\n');
+                return out;
+            }
+            policy->violations(out, path, result.summary);
+            return out;
+        }
+
+        switch (format) {
+            case Format::Text: {
+                out.reserve(64 + path.size() + 32 * checksec::kMitigationCount);
+                out.append("Results for: ").append(path);
+                if (!duplicateOf.empty()) {
+                    out.append(" (duplicate of ").append(duplicateOf).append(1, ')');
+                }
+                out.append(1, '\n');
+                checksec::cli::renderText(out, result);
+                out.append(1, '\n');
+                return out;
+            }
+            case Format::CSV:
+            case Format::TSV: {
+                out.reserve(path.size() + 16 * checksec::kMitigationCount);
+                checksec::cli::renderDelimited(out, path, result,
+                                               format == Format::CSV ? ',' : '\t');
+                return out;
+            }
+            case Format::Store: {
+                // NOTE: Rows are handed to the store's writer as the packed presences,
+                // followed by the path.
+                auto bits = result.summary.bits();
+                out.reserve(sizeof(bits) + path.size());
+                out.append(reinterpret_cast<const char*>(&bits), sizeof(bits)).append(path);
+                return out;
+            }
+            default: {
+                break;
+            }
+        }
+
+        nlohmann::json j = result;
+        j["path"] = path;
+        if (!duplicateOf.empty()) {
+            j["duplicateOf"] = duplicateOf;
+        }
+        return format == Format::JSON ? j.dump() : j.dump() + '\n';
+    };
+    // NOTE: Partial results (from a subset of the checks) are never cached, but complete
+    // cached results can stand in for them.
+    // The cache doesn't hold --deep-gs or --imports results, but they can still be stored in it.
+    bool deepGS = cmdl["--deep-gs"];
+    bool imports = cmdl["--imports"];
+    // NOTE: With a memory budget, each file is charged its size (the most that its scan can
+    // hold in memory) until its results are detached from it.
+    // NOTE: A file's deadline starts once it's been loaded into the budget, so that waiting
+    // on other files doesn't count against it. Unscanned files are never cached.
+    // NOTE: With --fail-fast, scans also watch the pool's cancellation, so that the scans still
+    // in flight after the first violation are abandoned (as if they'd timed out) rather than
+    // finished. The pool is created below, and sets this before any file is submitted.
+    const std::atomic<bool>* cancellation = nullptr;
+    auto scan = [&cache, &budget, &cancellation, checks, deepGS, imports, maxFileSize, timeout](
+                    const std::string& path, checksec::PhaseTimings& timings, bool& cached) {
+        std::optional<checksec::cli::ResultCache::Key> key;
+        if (cache && (key = cache->key(path))) {
+            if (auto result = deepGS || imports ? std::nullopt : cache->lookup(*key)) {
+                cached = true;
+                if (checks != checksec::kAllChecks) {
+                    result->restrict(checks);
+                }
+                return std::move(*result);
+            }
+        }
+
+        std::uint64_t size = 0;
+        if (budget || maxFileSize) {
+            std::error_code ec;
+            size = std::filesystem::file_size(path, ec);
+            size = ec ? 0 : size;
+        }
+        if (maxFileSize && size > *maxFileSize) {
+            return checksec::cli::ScanResult::unscanned(checksec::cli::ScanStatus::Skipped);
+        }
+
+        std::optional<checksec::cli::ByteBudget::Reservation> reservation;
+        if (budget) {
+            reservation.emplace(budget->reserve(size));
+        }
+
+        std::optional<checksec::ScopedDeadline> deadline;
+        std::optional<std::chrono::steady_clock::time_point> until;
+        if (timeout) {
+            until = std::chrono::steady_clock::now() + *timeout;
+        }
+        if (cancellation) {
+            deadline.emplace(until, *cancellation);
+        } else if (until) {
+            deadline.emplace(*until);
+        }
+
+        // The optional scans need the image, so they're run before it's freed.
+        std::optional<checksec::GSInstrumentation> gsInstrumentation;
+        std::optional<std::vector<checksec::ImportFinding>> riskyImports;
+        std::optional<checksec::DetachedResult> detached;
         try {
-            checksec::Checksec csec(*path);
+            checksec::Checksec checksec(path, checksec::LoadMode::HeadersOnly, checks);
+            if (deepGS) {
+                gsInstrumentation = checksec.gsInstrumentation();
+            }
+            if (imports) {
+                riskyImports = checksec.riskyImports();
+            }
+            detached = checksec.detach();
+        } catch (checksec::TimeoutError&) {
+            return checksec::cli::ScanResult::unscanned(checksec::cli::ScanStatus::TimedOut);
+        }
+        deadline.reset();
+        reservation.reset();
+
+        auto result = checksec::cli::ScanResult::from(*detached);
+        result.gsInstrumentation = gsInstrumentation;
+        result.riskyImports = std::move(riskyImports);
+        timings = detached->timings;
+        if (key && checks == checksec::kAllChecks) {
+            cache->store(*key, result);
+        }
+        return result;
+    };
+    // NOTE: With --dedup, only the first file with each distinct contents is scanned; the
+    // others wait for its result, and count as cached in the stats.
+    auto resolve = [&](const std::string& path, checksec::PhaseTimings& timings, bool& cached,
+                       std::string& duplicateOf) {
+        if (!dedup) {
+            return scan(path, timings, cached);
+        }
+
+        auto claim = dedup->claim(path);
+        if (!claim.owner()) {
+            duplicateOf = claim.ownerPath();
+            cached = true;
+        }
+        return claim.resolve([&] { return scan(path, timings, cached); });
+    };
+    auto process = [&](const std::string& path) {
+        std::string duplicateOf;
+        if (!stats) {
+            checksec::PhaseTimings timings;
+            bool cached = false;
+            return render(path, resolve(path, timings, cached, duplicateOf), duplicateOf);
+        }
 
-            if (json) {
-                results.push_back(csec);
+        auto start = std::chrono::steady_clock::now();
+        checksec::PhaseTimings timings;
+        bool cached = false;
+        auto result = resolve(path, timings, cached, duplicateOf);
+        auto rendering = std::chrono::steady_clock::now();
+        auto rendered = render(path, result, duplicateOf);
+        auto end = std::chrono::steady_clock::now();
+
+        auto nanoseconds = [](auto duration) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        };
+        timings.nanoseconds[static_cast<std::size_t>(checksec::Phase::Serialize)] =
+            nanoseconds(end - rendering);
+        stats->record(path, timings, nanoseconds(end - start), cached, result.status);
+        return rendered;
+    };
+    // NOTE: With --fail-fast, the first worker to find a violation cancels the pool, rather
+    // than waiting for its result to come back in order. That violation is kept aside, since
+    // cancelled results are never returned.
+    std::mutex violationMutex;
+    std::string firstViolation;
+    auto work = [&](const Candidate& c) {
+        if (!c.discovered) {
+            return process(c.path);
+        }
+
+        if (!checksec::cli::looksLikePE(c.path)) {
+            return std::string();
+        }
+        try {
+            return process(c.path);
+        } catch (checksec::ChecksecError& error) {
+            std::cerr << "Warn: " << c.path << ": " << error.what() << "\n";
+            return std::string();
+        }
+    };
+    checksec::cli::OrderedPool<Candidate, std::string> pool(jobs, [&](const Candidate& c) {
+        auto result = work(c);
+        if (failFast && !result.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(violationMutex);
+                if (firstViolation.empty()) {
+                    firstViolation = result;
+                }
+            }
+            pool.cancel();
+        }
+        return result;
+    });
+    if (failFast) {
+        cancellation = &pool.cancellation();
+    }
+    const std::size_t window = pool.jobs() * 64;
+
+    // NOTE: Files are read ahead as they're submitted to the pool, so read-ahead runs up to
+    // a window's worth of files ahead of the workers.
+    std::optional<checksec::cli::ReadAhead> readAhead;
+    if (cmdl("--readahead")) {
+        std::size_t depth = 0;
+        if (!(cmdl("--readahead") >> depth) || depth == 0) {
+            usage(argv);
+            return 1;
+        }
+        readAhead.emplace(depth, checks, deepGS);
+    }
+
+    // NOTE: Paths named on the command line come first, then any listed paths, then any
+    // discovered ones. Listed paths are read one at a time, so that scanning starts while the
+    // list is still being produced.
+    auto arg = paths.begin();
+    auto nextCandidate = [&]() -> std::optional<Candidate> {
+        if (arg != paths.end()) {
+            return Candidate{std::move(*arg++), false};
+        }
+        if (reader) {
+            if (auto path = reader->next()) {
+                return Candidate{std::move(*path), false};
+            }
+            reader.reset();
+        }
+        if (walker) {
+            if (auto path = walker->next()) {
+                return Candidate{std::move(*path), true};
+            }
+        }
+        return std::nullopt;
+    };
+
+    // NOTE: JSON output is a single document, so it's held back until the scan is complete;
+    // the other formats are streamed out in chunks, and flushed whenever we'd otherwise block
+    // waiting on a worker. Violation lines replace the output format entirely, and are always
+    // streamed as plain text.
+    checksec::cli::ChunkedWriter out(std::cout);
+    bool formatted = !aggregate && !policy;
+    std::string results;
+    std::optional<checksec::cli::ResultStoreWriter> store;
+    if (format == Format::Store && formatted) {
+        store.emplace();
+    }
+    if ((format == Format::CSV || format == Format::TSV) && formatted) {
+        std::string header;
+        checksec::cli::renderDelimitedHeader(header, format == Format::CSV ? ',' : '\t');
+        out.write(header);
+    }
+    std::size_t violations = 0;
+    auto emit = [&](const std::string& result) {
+        if (result.empty()) {
+            return;
+        }
+        violations += policy.has_value();
+
+        if (format == Format::JSON && formatted) {
+            results += results.empty() ? "" : ",";
+            results += result;
+        } else if (store) {
+            std::uint64_t bits;
+            std::memcpy(&bits, result.data(), sizeof(bits));
+            store->add(std::string_view(result).substr(sizeof(bits)),
+                       checksec::MitigationSummary(bits, 0));
+        } else {
+            out.write(result);
+        }
+    };
+    auto candidate = nextCandidate();
+    while (!pool.cancelled()) {
+        try {
+            std::optional<std::string> result;
+            if (candidate && pool.pending() < window) {
+                if (readAhead) {
+                    readAhead->submit(candidate->path);
+                }
+                pool.submit(std::move(*candidate));
+
+                // NOTE: The next listed path may be a long time coming from a slow producer,
+                // so the results that are already done go out before we wait for it.
+                if (arg == paths.end() && reader && !reader->ready()) {
+                    while (auto done = pool.tryNext()) {
+                        emit(*done);
+                    }
+                    out.flush();
+                }
+                candidate = nextCandidate();
+                result = pool.tryNext();
             } else {
-                std::cout << "Results for: " << *path << '\n';
-                std::cout << csec << '\n';
+                if (!(result = pool.tryNext())) {
+                    out.flush();
+                    result = pool.next();
+                }
+            }
+
+            if (!result) {
+                if (!candidate && pool.pending() == 0) {
+                    break;
+                }
+                continue;
             }
+            emit(*result);
         } catch (checksec::ChecksecError& error) {
+            out.flush();
             std::cerr << error.what() << '\n';
             usage(argv);
             return 2;
         } catch (...) {
+            out.flush();
             std::cerr << "General error" << '\n';
             usage(argv);
             return 3;
         }
     }
 
-    if (json) {
-        std::cout << results << '\n';
+    if (pool.cancelled()) {
+        // NOTE: Workers may still be abandoning the files they'd already started, but their
+        // results are no longer needed.
+        std::lock_guard<std::mutex> lock(violationMutex);
+        if (violations == 0) {
+            out.write(firstViolation);
+            ++violations;
+        }
+    }
+    out.flush();
+
+    if (aggregate) {
+        if (format == Format::JSON || format == Format::JSONL) {
+            std::cout << aggregate->toJson().dump() << '\n';
+        } else {
+            aggregate->print(std::cout);
+        }
+    } else if (format == Format::JSON && formatted) {
+        std::cout << '[' << results << ']' << '\n';
+    }
+    if (store) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        if (!store->write(std::cout)) {
+            std::cerr << "Err: couldn't write the result store" << '\n';
+            return 2;
+        }
+    }
+
+    if (cmdl["--stats"]) {
+        stats->print(std::cerr);
+        if (budget) {
+            std::cerr << "Peak memory budget in use: " << budget->peak() << " bytes" << "\n";
+        }
+        if (readAhead) {
+            std::cerr << "Files read ahead: " << readAhead->files() << " (" << readAhead->backend()
+                      << ")" << "\n";
+        }
+    }
+    if (statsJson) {
+        std::ofstream file(statsJson.str());
+        if (!(file << stats->toJson().dump(2) << '\n')) {
+            std::cerr << "Warn: couldn't write stats to " << statsJson.str() << "\n";
+        }
+    }
+
+    if (pool.cancelled()) {
+        std::cerr << "Stopped at the first policy violation" << "\n";
+        return 4;
+    } else if (violations != 0) {
+        std::cerr << violations << " file(s) violate the policy" << "\n";
+        return 4;
     }
 
     return 0;
@@ -0,0 +1,206 @@
+#include "checksec.h"
+
+#include <algorithm>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define WINCHECKSEC_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace checksec {
+
+namespace impl {
+namespace {
+#ifdef WINCHECKSEC_SIMD_X86
+#if defined(__GNUC__) || defined(__clang__)
+#define WINCHECKSEC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define WINCHECKSEC_TARGET_AVX2
+#endif
+
+unsigned countTrailingZeros(std::uint32_t n) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, n);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(n));
+#endif
+}
+
+bool hasAVX2() {
+#ifdef _MSC_VER
+    // NOTE: AVX2 also needs the OS to save the YMM registers, per XGETBV.
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+}  // namespace
+
+bool PatternScanner::supports(ScanBackend backend) {
+    switch (backend) {
+        case ScanBackend::Auto:
+        case ScanBackend::Scalar: {
+            return true;
+        }
+#ifdef WINCHECKSEC_SIMD_X86
+        case ScanBackend::SSE2: {
+            return true;
+        }
+        case ScanBackend::AVX2: {
+            static const bool avx2 = hasAVX2();
+            return avx2;
+        }
+#endif
+        default: {
+            return false;
+        }
+    }
+}
+
+PatternScanner::PatternScanner(std::vector<BytePattern> patterns, ScanBackend backend)
+    : patterns_(std::move(patterns)), backend_(backend) {
+    if (backend_ == ScanBackend::Auto) {
+        backend_ = supports(ScanBackend::AVX2)   ? ScanBackend::AVX2
+                   : supports(ScanBackend::SSE2) ? ScanBackend::SSE2
+                                                 : ScanBackend::Scalar;
+    } else if (!supports(backend_)) {
+        throw ChecksecError("pattern scanner backend isn't supported on this CPU");
+    }
+
+    for (auto& pattern : patterns_) {
+        pattern.size = std::clamp<std::size_t>(pattern.size, 2, BytePattern::kMaxSize);
+        for (std::size_t i = 0; i < pattern.size; ++i) {
+            pattern.value[i] &= pattern.mask[i];
+        }
+    }
+}
+
+void PatternScanner::verify(const std::uint8_t* data, std::size_t size, std::size_t offset,
+                            std::vector<Match>& matches) const {
+    for (std::size_t k = 0; k < patterns_.size(); ++k) {
+        const auto& pattern = patterns_[k];
+        if (pattern.size > size - offset) {
+            continue;
+        }
+
+        std::size_t i = 0;
+        while (i < pattern.size && (data[offset + i] & pattern.mask[i]) == pattern.value[i]) {
+            ++i;
+        }
+        if (i == pattern.size) {
+            matches.push_back({offset, k});
+        }
+    }
+}
+
+#ifdef WINCHECKSEC_SIMD_X86
+namespace {
+// NOTE: The patterns' bytes are broadcast where they're used rather than up front, since
+// the vector types can't be kept in a std::vector without losing their alignment.
+__m128i broadcast128(std::uint8_t byte) { return _mm_set1_epi8(static_cast<char>(byte)); }
+
+WINCHECKSEC_TARGET_AVX2 __m256i broadcast256(std::uint8_t byte) {
+    return _mm256_set1_epi8(static_cast<char>(byte));
+}
+
+// NOTE: Each vector step tests the positions [i, i + width), which reads one byte past
+// them for the patterns' second bytes; the scalar loop picks up wherever that would overrun.
+std::size_t scanSSE2(const std::vector<BytePattern>& patterns, const std::uint8_t* data,
+                     std::size_t size, std::vector<std::size_t>& candidates) {
+    std::size_t i = 0;
+    for (; i + 16 + 1 <= size; i += 16) {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        __m128i any = _mm_setzero_si128();
+        for (const auto& pattern : patterns) {
+            __m128i match0 = _mm_cmpeq_epi8(_mm_and_si128(first, broadcast128(pattern.mask[0])),
+                                            broadcast128(pattern.value[0]));
+            __m128i match1 = _mm_cmpeq_epi8(_mm_and_si128(second, broadcast128(pattern.mask[1])),
+                                            broadcast128(pattern.value[1]));
+            any = _mm_or_si128(any, _mm_and_si128(match0, match1));
+        }
+
+        for (auto bits = static_cast<std::uint32_t>(_mm_movemask_epi8(any)); bits != 0;
+             bits &= bits - 1) {
+            candidates.push_back(i + countTrailingZeros(bits));
+        }
+    }
+    return i;
+}
+
+WINCHECKSEC_TARGET_AVX2 std::size_t scanAVX2(const std::vector<BytePattern>& patterns,
+                                             const std::uint8_t* data, std::size_t size,
+                                             std::vector<std::size_t>& candidates) {
+    std::size_t i = 0;
+    for (; i + 32 + 1 <= size; i += 32) {
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+        __m256i any = _mm256_setzero_si256();
+        for (const auto& pattern : patterns) {
+            __m256i match0 = _mm256_cmpeq_epi8(
+                _mm256_and_si256(first, broadcast256(pattern.mask[0])),
+                broadcast256(pattern.value[0]));
+            __m256i match1 = _mm256_cmpeq_epi8(
+                _mm256_and_si256(second, broadcast256(pattern.mask[1])),
+                broadcast256(pattern.value[1]));
+            any = _mm256_or_si256(any, _mm256_and_si256(match0, match1));
+        }
+
+        for (auto bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(any)); bits != 0;
+             bits &= bits - 1) {
+            candidates.push_back(i + countTrailingZeros(bits));
+        }
+    }
+    return i;
+}
+}  // namespace
+#endif
+
+void PatternScanner::scan(const std::uint8_t* data, std::size_t size,
+                          std::vector<Match>& matches) const {
+    if (patterns_.empty()) {
+        return;
+    }
+
+    std::size_t i = 0;
+#ifdef WINCHECKSEC_SIMD_X86
+    if (backend_ != ScanBackend::Scalar) {
+        std::vector<std::size_t> candidates;
+        i = backend_ == ScanBackend::AVX2 ? scanAVX2(patterns_, data, size, candidates)
+                                          : scanSSE2(patterns_, data, size, candidates);
+        for (auto offset : candidates) {
+            verify(data, size, offset, matches);
+        }
+    }
+#endif
+
+    for (; i + 1 < size; ++i) {
+        for (const auto& pattern : patterns_) {
+            if ((data[i] & pattern.mask[0]) == pattern.value[0] &&
+                (data[i + 1] & pattern.mask[1]) == pattern.value[1]) {
+                verify(data, size, i, matches);
+                break;
+            }
+        }
+    }
+}
+}  // namespace impl
+
+}  // namespace checksec
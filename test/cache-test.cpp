@@ -0,0 +1,247 @@
+#include "gtest/gtest.h"
+
+#include <checksec.h>
+
+#include "cli/cache.h"
+#include "temp-file.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+using checksec::Mitigation;
+using checksec::MitigationPresence;
+using checksec::cli::ResultCache;
+using checksec::cli::ScanResult;
+using checksec::test::TempFile;
+
+namespace {
+// NOTE: The header is 16 bytes (magic, version, record size and mitigation count), and each
+// record is 96.
+constexpr std::size_t kHeaderSize = 16;
+constexpr std::size_t kRecordSize = 96;
+
+ScanResult sampleResult(std::uint16_t targetMachine) {
+    ScanResult result;
+    result.summary.set(Mitigation::NX, MitigationPresence::Present);
+    result.summary.set(Mitigation::CFG, MitigationPresence::NotPresent);
+    result.summary.set(Mitigation::SafeSEH, MitigationPresence::NotApplicable, 1);
+    result.authenticodeDigest = checksec::AuthenticodeDigest{
+        "SHA256", "00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff"};
+    result.targetMachine = targetMachine;
+    result.is64Bit = true;
+    return result;
+}
+
+void expectSameResult(const ScanResult &actual, const ScanResult &expected) {
+    EXPECT_EQ(actual.summary, expected.summary);
+    ASSERT_EQ(actual.authenticodeDigest.has_value(), expected.authenticodeDigest.has_value());
+    if (expected.authenticodeDigest) {
+        EXPECT_EQ(actual.authenticodeDigest->algorithm, expected.authenticodeDigest->algorithm);
+        EXPECT_EQ(actual.authenticodeDigest->digest, expected.authenticodeDigest->digest);
+    }
+    EXPECT_EQ(actual.targetMachine, expected.targetMachine);
+    EXPECT_EQ(actual.is64Bit, expected.is64Bit);
+}
+}  // namespace
+
+TEST(ResultCache, StoreAndLookup) {
+    TempFile file("winchecksec-cache-lookup.cache");
+    ResultCache::Key signed64{1, 100, 4096, 1234567890123, 0};
+    ResultCache::Key unsigned32{1, 101, 512, 1234567890124, 0};
+    ScanResult plain;
+    plain.summary.set(Mitigation::DynamicBase, MitigationPresence::NotPresent);
+    plain.targetMachine = 0x14c;
+
+    {
+        ResultCache cache(file.path(), false);
+        cache.store(signed64, sampleResult(0x8664));
+        cache.store(unsigned32, plain);
+        // Results stored in this run aren't visible until the cache is reopened.
+        EXPECT_FALSE(cache.lookup(signed64).has_value());
+    }
+    EXPECT_EQ(file.read().size(), kHeaderSize + 2 * kRecordSize);
+
+    ResultCache cache(file.path(), false);
+    auto hit = cache.lookup(signed64);
+    ASSERT_TRUE(hit.has_value());
+    expectSameResult(*hit, sampleResult(0x8664));
+    EXPECT_EQ(hit->summary.explanation(Mitigation::SafeSEH),
+              sampleResult(0).summary.explanation(Mitigation::SafeSEH));
+
+    hit = cache.lookup(unsigned32);
+    ASSERT_TRUE(hit.has_value());
+    expectSameResult(*hit, plain);
+
+    EXPECT_FALSE(cache.lookup({1, 102, 512, 1234567890124, 0}).has_value());
+    EXPECT_FALSE(cache.lookup({2, 100, 4096, 1234567890123, 0}).has_value());
+}
+
+TEST(ResultCache, InvalidatedByChanges) {
+    TempFile file("winchecksec-cache-invalidate.cache");
+    ResultCache::Key key{1, 100, 4096, 1234567890123, 42};
+    {
+        ResultCache cache(file.path(), true);
+        cache.store(key, sampleResult(0x8664));
+    }
+
+    ResultCache cache(file.path(), true);
+    EXPECT_TRUE(cache.lookup(key).has_value());
+
+    auto resized = key;
+    resized.size += 1;
+    EXPECT_FALSE(cache.lookup(resized).has_value());
+
+    auto touched = key;
+    touched.mtimeNs += 1;
+    EXPECT_FALSE(cache.lookup(touched).has_value());
+
+    auto rewritten = key;
+    rewritten.contentHash = 43;
+    EXPECT_FALSE(cache.lookup(rewritten).has_value());
+}
+
+TEST(ResultCache, KeysFollowTheFile) {
+    TempFile scanned("winchecksec-cache-scanned.bin");
+    scanned.write("MZ first version");
+
+    TempFile file("winchecksec-cache-keys.cache");
+    ResultCache cache(file.path(), true);
+    auto key = cache.key(scanned.path());
+    ASSERT_TRUE(key.has_value());
+    EXPECT_EQ(key->size, 16u);
+    EXPECT_NE(key->contentHash, 0u);
+    EXPECT_FALSE(cache.key(scanned.path() + ".missing").has_value());
+
+    // Same size and modification time, different contents: only the content hash notices.
+    auto mtime = std::filesystem::last_write_time(scanned.path());
+    scanned.write("MZ other version");
+    std::filesystem::last_write_time(scanned.path(), mtime);
+    auto rewritten = cache.key(scanned.path());
+    ASSERT_TRUE(rewritten.has_value());
+    EXPECT_EQ(rewritten->size, key->size);
+    EXPECT_EQ(rewritten->mtimeNs, key->mtimeNs);
+    EXPECT_NE(rewritten->contentHash, key->contentHash);
+
+    std::filesystem::last_write_time(scanned.path(), mtime + std::chrono::seconds(1));
+    auto touched = cache.key(scanned.path());
+    ASSERT_TRUE(touched.has_value());
+    EXPECT_NE(touched->mtimeNs, key->mtimeNs);
+
+    scanned.write("MZ a longer version");
+    auto resized = cache.key(scanned.path());
+    ASSERT_TRUE(resized.has_value());
+    EXPECT_NE(resized->size, key->size);
+}
+
+TEST(ResultCache, IgnoresOlderVersions) {
+    TempFile file("winchecksec-cache-version.cache");
+    ResultCache::Key key{1, 100, 4096, 1234567890123, 0};
+    {
+        ResultCache cache(file.path(), false);
+        cache.store(key, sampleResult(0x8664));
+    }
+
+    // Downgrade the header's version, as if the cache were written by an older winchecksec.
+    auto contents = file.read();
+    ASSERT_EQ(contents.size(), kHeaderSize + kRecordSize);
+    std::uint32_t version;
+    std::memcpy(&version, &contents[8], sizeof(version));
+    --version;
+    std::memcpy(&contents[8], &version, sizeof(version));
+    file.write(contents);
+
+    {
+        ResultCache cache(file.path(), false);
+        EXPECT_FALSE(cache.lookup(key).has_value());
+        cache.store(key, sampleResult(0x14c));
+    }
+
+    // The old records are dropped, and the cache is rewritten at the current version.
+    contents = file.read();
+    ASSERT_EQ(contents.size(), kHeaderSize + kRecordSize);
+    std::uint32_t rewritten;
+    std::memcpy(&rewritten, &contents[8], sizeof(rewritten));
+    EXPECT_EQ(rewritten, version + 1);
+    EXPECT_FALSE(std::filesystem::exists(file.path() + ".tmp"));
+
+    ResultCache cache(file.path(), false);
+    auto hit = cache.lookup(key);
+    ASSERT_TRUE(hit.has_value());
+    expectSameResult(*hit, sampleResult(0x14c));
+}
+
+TEST(ResultCache, CompactsSupersededRecords) {
+    TempFile file("winchecksec-cache-compact.cache");
+    ResultCache::Key rescanned{1, 100, 4096, 1234567890123, 0};
+    ResultCache::Key untouched{1, 101, 512, 1234567890124, 0};
+
+    // Each run rescans one file and appends its record, until superseded records outnumber
+    // live ones and the cache is rewritten (through a temporary file) with only the newest.
+    const std::size_t expectedRecords[] = {2, 3, 4, 2, 3};
+    for (std::uint16_t run = 0; run < std::size(expectedRecords); ++run) {
+        {
+            ResultCache cache(file.path(), false);
+            if (run == 0) {
+                cache.store(untouched, sampleResult(0x14c));
+            } else {
+                auto previous = cache.lookup(rescanned);
+                ASSERT_TRUE(previous.has_value()) << run;
+                EXPECT_EQ(previous->targetMachine, run - 1u) << run;
+            }
+            cache.store(rescanned, sampleResult(run));
+        }
+
+        EXPECT_EQ(file.read().size(), kHeaderSize + expectedRecords[run] * kRecordSize) << run;
+        EXPECT_FALSE(std::filesystem::exists(file.path() + ".tmp")) << run;
+    }
+
+    ResultCache cache(file.path(), false);
+    auto hit = cache.lookup(rescanned);
+    ASSERT_TRUE(hit.has_value());
+    EXPECT_EQ(hit->targetMachine, std::size(expectedRecords) - 1);
+    hit = cache.lookup(untouched);
+    ASSERT_TRUE(hit.has_value());
+    expectSameResult(*hit, sampleResult(0x14c));
+}
+
+TEST(ResultCache, RecoversFromTornRecords) {
+    TempFile file("winchecksec-cache-torn.cache");
+    ResultCache::Key first{1, 100, 4096, 1234567890123, 0};
+    ResultCache::Key torn{1, 101, 512, 1234567890124, 0};
+    ResultCache::Key later{1, 102, 1024, 1234567890125, 0};
+    {
+        ResultCache cache(file.path(), false);
+        cache.store(first, sampleResult(0x14c));
+        cache.store(torn, sampleResult(0x8664));
+    }
+
+    // Cut the last record short, as an interrupted write would.
+    auto contents = file.read();
+    ASSERT_EQ(contents.size(), kHeaderSize + 2 * kRecordSize);
+    file.write(contents.substr(0, contents.size() - 40));
+
+    {
+        ResultCache cache(file.path(), false);
+        EXPECT_TRUE(cache.lookup(first).has_value());
+        EXPECT_FALSE(cache.lookup(torn).has_value());
+        cache.store(later, sampleResult(0x1c4));
+    }
+
+    // The partial record is dropped rather than appended after, and later runs append as usual.
+    EXPECT_EQ(file.read().size(), kHeaderSize + 2 * kRecordSize);
+    EXPECT_FALSE(std::filesystem::exists(file.path() + ".tmp"));
+    {
+        ResultCache cache(file.path(), false);
+        cache.store(torn, sampleResult(0xaa64));
+    }
+    EXPECT_EQ(file.read().size(), kHeaderSize + 3 * kRecordSize);
+
+    ResultCache cache(file.path(), false);
+    for (auto [key, machine] : {std::pair{first, 0x14c}, {later, 0x1c4}, {torn, 0xaa64}}) {
+        auto hit = cache.lookup(key);
+        ASSERT_TRUE(hit.has_value()) << machine;
+        expectSameResult(*hit, sampleResult(static_cast<std::uint16_t>(machine)));
+    }
+}
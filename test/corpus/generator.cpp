@@ -0,0 +1,528 @@
+#include "generator.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace checksec::corpus {
+
+namespace {
+// NOTE: Offsets and sizes below are from the PE format documentation:
+// https://docs.microsoft.com/en-us/windows/win32/debug/pe-format
+constexpr std::uint32_t kNtHeadersOffset = 0x80;
+constexpr std::uint32_t kFileAlignment = 0x200;
+constexpr std::uint32_t kSectionAlignment = 0x1000;
+constexpr std::uint32_t kSizeOfHeaders = 0x400;
+constexpr std::uint32_t kNumberOfSections = 3;
+
+constexpr std::uint32_t kTextRva = 0x1000;
+constexpr std::uint32_t kRdataRva = 0x2000;
+
+// Functions start after .text's initial `ret`, and each takes up the same space.
+constexpr std::uint32_t kFunctionsOffset = 0x10;
+constexpr std::uint32_t kFunctionSize = 40;
+constexpr std::uint32_t kMaxFunctions = 100;
+constexpr std::uint32_t kRuntimeFunctionSize = 12;
+
+// The full sizes of the load config structures, as of the Windows 10 SDK.
+constexpr std::uint32_t kLoadConfigSize32 = 160;
+constexpr std::uint32_t kLoadConfigSize64 = 256;
+
+// Enough room for the EH continuation and XFG fields that later SDKs added.
+constexpr std::uint32_t kLoadConfigSizeMax = 320;
+
+// Data directory indices.
+constexpr std::size_t kDirImport = 1;
+constexpr std::size_t kDirException = 3;
+constexpr std::size_t kDirSecurity = 4;
+constexpr std::size_t kDirDebug = 6;
+constexpr std::size_t kDirLoadConfig = 10;
+constexpr std::size_t kDirDelayImport = 13;
+constexpr std::size_t kDirComDescriptor = 14;
+
+constexpr std::uint32_t kImportDescriptorSize = 20;
+constexpr std::uint32_t kDelayImportDescriptorSize = 32;
+
+// A mix of risky and harmless imports, for random specs.
+constexpr const char* kImportNames[] = {
+    "GetTickCount",       "CloseHandle",         "VirtualProtect", "GetProcAddress",
+    "LoadLibraryExW",     "HeapAlloc",           "CreateFileW",    "QueueUserAPC",
+    "WriteProcessMemory", "SetProcessDEPPolicy", "SetThreadContext",
+};
+
+constexpr std::uint32_t kDebugEntrySize = 28;
+constexpr std::uint32_t kDebugTypeExDllCharacteristics = 20;
+constexpr std::uint32_t kDebugTypes[] = {
+    2,  // CODEVIEW
+    12, // VC_FEATURE
+    13, // POGO
+    16, // REPRO
+};
+
+constexpr std::uint16_t kDllCharacteristics[] = {
+    0x0020, // HIGH_ENTROPY_VA
+    0x0040, // DYNAMIC_BASE
+    0x0080, // FORCE_INTEGRITY
+    0x0100, // NX_COMPAT
+    0x0200, // NO_ISOLATION
+    0x0400, // NO_SEH
+    0x4000, // GUARD_CF
+    0x8000, // TERMINAL_SERVER_AWARE
+};
+
+constexpr std::uint32_t kGuardFlags[] = {
+    0x00000100, // CF_INSTRUMENTED
+    0x00000400, // CF_FUNCTION_TABLE_PRESENT
+    0x00020000, // RF_INSTRUMENTED
+    0x00040000, // RF_ENABLE
+    0x00080000, // RF_STRICT
+    0x00400000, // EH_CONTINUATION_TABLE_PRESENT
+    0x00800000, // XFG_ENABLED
+    0x10000000, // One byte of metadata per function table entry
+};
+
+std::uint32_t alignUp(std::uint32_t value, std::uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void put16(std::vector<std::uint8_t>& buf, std::size_t offset, std::uint16_t value) {
+    buf[offset] = value & 0xff;
+    buf[offset + 1] = value >> 8;
+}
+
+void put32(std::vector<std::uint8_t>& buf, std::size_t offset, std::uint32_t value) {
+    put16(buf, offset, value & 0xffff);
+    put16(buf, offset + 2, value >> 16);
+}
+
+void put64(std::vector<std::uint8_t>& buf, std::size_t offset, std::uint64_t value) {
+    put32(buf, offset, value & 0xffffffff);
+    put32(buf, offset + 4, value >> 32);
+}
+
+void putSection(std::vector<std::uint8_t>& buf, std::size_t offset, const char* name,
+                std::uint32_t virtualSize, std::uint32_t rva, std::uint32_t rawSize,
+                std::uint32_t rawOffset, std::uint32_t characteristics) {
+    std::memcpy(&buf[offset], name, std::strlen(name));
+    put32(buf, offset + 8, virtualSize);
+    put32(buf, offset + 12, rva);
+    put32(buf, offset + 16, rawSize);
+    put32(buf, offset + 20, rawOffset);
+    put32(buf, offset + 36, characteristics);
+}
+
+// Draws from [0, n) using only the generator's raw output; see randomSpec.
+std::uint64_t below(std::mt19937_64& rng, std::uint64_t n) { return n == 0 ? 0 : rng() % n; }
+
+bool chance(std::mt19937_64& rng, std::uint64_t oneIn) { return below(rng, oneIn) == 0; }
+}  // namespace
+
+ImageSpec randomSpec(std::mt19937_64& rng, const SpecLimits& limits) {
+    ImageSpec spec;
+    spec.pe64 = chance(rng, 2);
+
+    std::uint64_t bits = rng();
+    for (std::size_t i = 0; i < std::size(kDllCharacteristics); ++i) {
+        if (bits & (1ull << i)) {
+            spec.dllCharacteristics |= kDllCharacteristics[i];
+        }
+    }
+    spec.relocsStripped = chance(rng, 8);
+
+    // NOTE: Weighted towards the interesting cases: the full structure, truncations at and
+    // around the field boundaries that the checks care about, and oversized load configs.
+    std::uint32_t full = spec.pe64 ? kLoadConfigSize64 : kLoadConfigSize32;
+    constexpr std::uint32_t kBoundaries[] = {64, 72, 92, 96, 112, 148};
+    switch (below(rng, 6)) {
+        case 0: {
+            spec.loadConfigSize = 0;
+            break;
+        }
+        case 1: {
+            spec.loadConfigSize = kBoundaries[below(rng, std::size(kBoundaries))];
+            break;
+        }
+        case 2: {
+            spec.loadConfigSize = 8 + below(rng, full - 8);
+            break;
+        }
+        case 3: {
+            spec.loadConfigSize = full + 1 + below(rng, 256);
+            break;
+        }
+        default: {
+            spec.loadConfigSize = full;
+            break;
+        }
+    }
+
+    bits = rng();
+    for (std::size_t i = 0; i < std::size(kGuardFlags); ++i) {
+        if (bits & (1ull << i)) {
+            spec.guardFlags |= kGuardFlags[i];
+        }
+    }
+    spec.securityCookie = !chance(rng, 4);
+    spec.seHandlers = chance(rng, 2);
+    spec.cfgFunctions = chance(rng, 2) ? static_cast<std::uint32_t>(below(rng, 256)) : 0;
+    spec.ehContinuations = chance(rng, 2) ? static_cast<std::uint32_t>(below(rng, 64)) : 0;
+    spec.guardTablesOutOfBounds = chance(rng, 8);
+    spec.xfg = chance(rng, 4);
+
+    // Occasionally, pathologically many debug directories.
+    spec.debugDirectories =
+        chance(rng, 64) ? 64 + below(rng, 1024) : static_cast<std::uint32_t>(below(rng, 5));
+    spec.cetCompat = chance(rng, 4);
+    spec.cetStrict = spec.cetCompat && chance(rng, 2);
+    spec.dotNET = chance(rng, 16);
+
+    // Data sections are log-uniformly sized, up to the limit.
+    std::uint32_t maxDataSize = std::max<std::uint32_t>(limits.maxDataSize, kFileAlignment);
+    std::uint32_t log2Max = 9;
+    while ((2ull << log2Max) <= maxDataSize) {
+        ++log2Max;
+    }
+    std::uint32_t magnitude = 1u << (9 + below(rng, log2Max - 8));
+    spec.dataSize = std::min(magnitude + static_cast<std::uint32_t>(below(rng, magnitude)),
+                             maxDataSize);
+
+    spec.signature = limits.signatures && chance(rng, 4);
+
+    if (chance(rng, 4)) {
+        spec.gsFunctions = static_cast<std::uint32_t>(below(rng, kMaxFunctions / 2));
+        spec.plainFunctions = static_cast<std::uint32_t>(below(rng, kMaxFunctions / 2));
+    }
+
+    if (chance(rng, 2)) {
+        for (std::uint64_t i = below(rng, 8); i > 0; --i) {
+            spec.imports.push_back(kImportNames[below(rng, std::size(kImportNames))]);
+        }
+        for (std::uint64_t i = below(rng, 3); i > 0; --i) {
+            spec.delayImports.push_back(kImportNames[below(rng, std::size(kImportNames))]);
+        }
+    }
+
+    return spec;
+}
+
+std::vector<std::uint8_t> buildImage(const ImageSpec& spec) {
+    const std::uint64_t imageBase = spec.pe64 ? 0x140000000ull : 0x400000;
+
+    // Lay out .rdata: the load config, then the debug directory, then the debug data, the CLR
+    // header and the guard tables.
+    std::vector<std::uint8_t> rdata(alignUp(spec.loadConfigSize, 8));
+    std::uint32_t debugOffset = static_cast<std::uint32_t>(rdata.size());
+    std::uint32_t debugCount = spec.debugDirectories + (spec.cetCompat ? 1 : 0);
+    std::uint32_t debugDataOffset = debugOffset + debugCount * kDebugEntrySize;
+    std::uint32_t exDataOffset = debugDataOffset + 16;
+    std::uint32_t clrOffset = exDataOffset + 8;
+    std::uint32_t cfgTableOffset = clrOffset + (spec.dotNET ? 72 : 0);
+    std::uint32_t guardStride = 4 + (spec.guardFlags >> 28);
+    std::uint32_t ehContOffset = cfgTableOffset + spec.cfgFunctions * guardStride;
+    std::uint32_t functions = std::min(spec.gsFunctions + spec.plainFunctions, kMaxFunctions);
+    std::uint32_t gsFunctions = std::min(spec.gsFunctions, functions);
+    std::uint32_t pdataOffset = alignUp(ehContOffset + spec.ehContinuations * guardStride, 4);
+    std::uint32_t pdataSize = spec.pe64 ? functions * kRuntimeFunctionSize : 0;
+    std::uint32_t unwindOffset = pdataOffset + pdataSize;
+    rdata.resize(unwindOffset + (pdataSize != 0 ? 4 : 0));
+
+    // The import tables come last: for each of the imports and the delay-load imports, a
+    // descriptor (and a null one), the name and address tables, then the names themselves.
+    std::uint32_t pointerSize = spec.pe64 ? 8 : 4;
+    auto putPointer = [&](std::size_t offset, std::uint64_t value) {
+        if (spec.pe64) {
+            put64(rdata, offset, value);
+        } else {
+            put32(rdata, offset, static_cast<std::uint32_t>(value));
+        }
+    };
+    auto putName = [&](const std::string& name, bool hint) {
+        std::uint32_t offset = alignUp(static_cast<std::uint32_t>(rdata.size()), 2);
+        rdata.resize(offset + (hint ? 2 : 0));
+        rdata.insert(rdata.end(), name.begin(), name.end());
+        rdata.push_back(0);
+        return offset;
+    };
+    std::uint32_t importsOffset = 0;
+    if (!spec.imports.empty()) {
+        auto count = static_cast<std::uint32_t>(spec.imports.size());
+        importsOffset = alignUp(static_cast<std::uint32_t>(rdata.size()), 8);
+        std::uint32_t lookupTable = importsOffset + 2 * kImportDescriptorSize;
+        std::uint32_t addressTable = lookupTable + (count + 1) * pointerSize;
+        rdata.resize(addressTable + (count + 1) * pointerSize);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            std::uint32_t name = kRdataRva + putName(spec.imports[i], true);
+            putPointer(lookupTable + i * pointerSize, name);
+            putPointer(addressTable + i * pointerSize, name);
+        }
+        put32(rdata, importsOffset, kRdataRva + lookupTable);
+        put32(rdata, importsOffset + 12, kRdataRva + putName("KERNEL32.dll", false));
+        put32(rdata, importsOffset + 16, kRdataRva + addressTable);
+    }
+    std::uint32_t delayImportsOffset = 0;
+    if (!spec.delayImports.empty()) {
+        auto count = static_cast<std::uint32_t>(spec.delayImports.size());
+        delayImportsOffset = alignUp(static_cast<std::uint32_t>(rdata.size()), 8);
+        std::uint32_t moduleHandle = delayImportsOffset + 2 * kDelayImportDescriptorSize;
+        std::uint32_t nameTable = moduleHandle + pointerSize;
+        std::uint32_t addressTable = nameTable + (count + 1) * pointerSize;
+        rdata.resize(addressTable + (count + 1) * pointerSize);
+        // NOTE: Delay-load address tables start out pointing at their (load) thunks, which
+        // are all .text's `ret` here.
+        for (std::uint32_t i = 0; i < count; ++i) {
+            putPointer(nameTable + i * pointerSize,
+                       kRdataRva + putName(spec.delayImports[i], true));
+            putPointer(addressTable + i * pointerSize, imageBase + kTextRva);
+        }
+        put32(rdata, delayImportsOffset, 1);  // RvaBased
+        put32(rdata, delayImportsOffset + 4, kRdataRva + putName("USER32.dll", false));
+        put32(rdata, delayImportsOffset + 8, kRdataRva + moduleHandle);
+        put32(rdata, delayImportsOffset + 12, kRdataRva + addressTable);
+        put32(rdata, delayImportsOffset + 16, kRdataRva + nameTable);
+    }
+    std::uint32_t textSize = kFunctionsOffset + functions * kFunctionSize;
+    std::uint32_t textRawSize = alignUp(textSize, kFileAlignment);
+    std::uint32_t rdataRaw = kSizeOfHeaders + textRawSize;
+    std::uint32_t rdataRawSize = alignUp(static_cast<std::uint32_t>(rdata.size()), kFileAlignment);
+    std::uint32_t dataRva =
+        kRdataRva + alignUp(static_cast<std::uint32_t>(rdata.size()), kSectionAlignment);
+    std::uint32_t dataRaw = rdataRaw + rdataRawSize;
+    std::uint32_t dataRawSize = alignUp(spec.dataSize, kFileAlignment);
+    std::uint32_t sizeOfImage = dataRva + alignUp(spec.dataSize, kSectionAlignment);
+
+    if (spec.loadConfigSize != 0) {
+        std::uint32_t full = spec.pe64 ? kLoadConfigSize64 : kLoadConfigSize32;
+        std::vector<std::uint8_t> loadConfig(
+            std::max({spec.loadConfigSize, full, kLoadConfigSizeMax}));
+        // NOTE: Out of bounds tables start one byte before the end of the image.
+        std::uint64_t tablesBase =
+            imageBase + (spec.guardTablesOutOfBounds ? sizeOfImage - 1 - cfgTableOffset
+                                                     : kRdataRva);
+        std::uint64_t cfgTable = spec.cfgFunctions ? tablesBase + cfgTableOffset : 0;
+        std::uint64_t ehContTable = spec.ehContinuations ? tablesBase + ehContOffset : 0;
+        std::uint64_t xfgCheck = spec.xfg ? imageBase + kTextRva : 0;
+        put32(loadConfig, 0, spec.loadConfigSize);
+        if (spec.pe64) {
+            put64(loadConfig, 88, spec.securityCookie ? imageBase + dataRva : 0);
+            put64(loadConfig, 96, spec.seHandlers ? imageBase + kRdataRva : 0);
+            put64(loadConfig, 104, spec.seHandlers ? 1 : 0);
+            put64(loadConfig, 128, cfgTable);
+            put64(loadConfig, 136, spec.cfgFunctions);
+            put32(loadConfig, 144, spec.guardFlags);
+            put64(loadConfig, 264, ehContTable);
+            put64(loadConfig, 272, spec.ehContinuations);
+            put64(loadConfig, 280, xfgCheck);
+        } else {
+            put32(loadConfig, 60, spec.securityCookie ? imageBase + dataRva : 0);
+            put32(loadConfig, 64, spec.seHandlers ? imageBase + kRdataRva : 0);
+            put32(loadConfig, 68, spec.seHandlers ? 1 : 0);
+            put32(loadConfig, 80, static_cast<std::uint32_t>(cfgTable));
+            put32(loadConfig, 84, spec.cfgFunctions);
+            put32(loadConfig, 88, spec.guardFlags);
+            put32(loadConfig, 164, static_cast<std::uint32_t>(ehContTable));
+            put32(loadConfig, 168, spec.ehContinuations);
+            put32(loadConfig, 172, static_cast<std::uint32_t>(xfgCheck));
+        }
+        std::copy_n(loadConfig.begin(), spec.loadConfigSize, rdata.begin());
+    }
+
+    for (std::uint32_t i = 0; i < debugCount; ++i) {
+        std::size_t entry = debugOffset + i * kDebugEntrySize;
+        bool ex = spec.cetCompat && i == debugCount - 1;
+        std::uint32_t dataOffset = ex ? exDataOffset : debugDataOffset;
+        put32(rdata, entry + 12, ex ? kDebugTypeExDllCharacteristics
+                                    : kDebugTypes[i % std::size(kDebugTypes)]);
+        put32(rdata, entry + 16, ex ? 4 : 16);
+        put32(rdata, entry + 20, kRdataRva + dataOffset);
+        put32(rdata, entry + 24, rdataRaw + dataOffset);
+    }
+    std::memcpy(&rdata[debugDataOffset], "RSDS", 4);
+    if (spec.cetCompat) {
+        // IMAGE_DLLCHARACTERISTICS_EX_CET_COMPAT, and _CET_COMPAT_STRICT_MODE
+        put32(rdata, exDataOffset, spec.cetStrict ? 0x3 : 0x1);
+    }
+    // Every guard table entry points at .text's `ret`.
+    for (std::uint32_t i = 0; i < spec.cfgFunctions + spec.ehContinuations; ++i) {
+        put32(rdata, cfgTableOffset + i * guardStride, kTextRva);
+    }
+    // Every function has the same (empty) unwind info: version 1, no unwind codes.
+    for (std::uint32_t i = 0; i < pdataSize / kRuntimeFunctionSize; ++i) {
+        std::uint32_t function = kTextRva + kFunctionsOffset + i * kFunctionSize;
+        put32(rdata, pdataOffset + i * kRuntimeFunctionSize, function);
+        put32(rdata, pdataOffset + i * kRuntimeFunctionSize + 4, function + kFunctionSize);
+        put32(rdata, pdataOffset + i * kRuntimeFunctionSize + 8, kRdataRva + unwindOffset);
+    }
+    if (pdataSize != 0) {
+        rdata[unwindOffset] = 1;
+    }
+    if (spec.dotNET) {
+        put32(rdata, clrOffset, 72);
+        put16(rdata, clrOffset + 4, 2);
+        put16(rdata, clrOffset + 6, 5);
+    }
+
+    std::vector<std::uint8_t> image(dataRaw + dataRawSize);
+
+    // DOS header.
+    image[0] = 'M';
+    image[1] = 'Z';
+    put32(image, 0x3c, kNtHeadersOffset);
+
+    // NT headers and the COFF file header.
+    std::size_t nt = kNtHeadersOffset;
+    std::memcpy(&image[nt], "PE\0\0", 4);
+    std::uint16_t characteristics = 0x0002;  // EXECUTABLE_IMAGE
+    characteristics |= spec.pe64 ? 0x0020 : 0x0100;  // LARGE_ADDRESS_AWARE : 32BIT_MACHINE
+    if (spec.relocsStripped) {
+        characteristics |= 0x0001;
+    }
+    std::uint16_t sizeOfOptionalHeader = spec.pe64 ? 240 : 224;
+    put16(image, nt + 4, spec.pe64 ? 0x8664 : 0x14c);
+    put16(image, nt + 6, kNumberOfSections);
+    put32(image, nt + 8, 0x5f000000);
+    put16(image, nt + 20, sizeOfOptionalHeader);
+    put16(image, nt + 22, characteristics);
+
+    // The optional header. Past ImageBase, PE32 and PE32+ only differ in the widths of the
+    // stack and heap sizes.
+    std::size_t opt = nt + 24;
+    put16(image, opt, spec.pe64 ? 0x20b : 0x10b);
+    image[opt + 2] = 14;
+    put32(image, opt + 4, textRawSize);
+    put32(image, opt + 8, rdataRawSize + dataRawSize);
+    put32(image, opt + 16, kTextRva);
+    put32(image, opt + 20, kTextRva);
+    if (spec.pe64) {
+        put64(image, opt + 24, imageBase);
+    } else {
+        put32(image, opt + 24, kRdataRva);
+        put32(image, opt + 28, static_cast<std::uint32_t>(imageBase));
+    }
+    put32(image, opt + 32, kSectionAlignment);
+    put32(image, opt + 36, kFileAlignment);
+    put16(image, opt + 40, 6);
+    put16(image, opt + 48, 6);
+    put32(image, opt + 56, sizeOfImage);
+    put32(image, opt + 60, kSizeOfHeaders);
+    put16(image, opt + 68, 3);  // IMAGE_SUBSYSTEM_WINDOWS_CUI
+    put16(image, opt + 70, spec.dllCharacteristics);
+
+    std::size_t dataDirectories;
+    if (spec.pe64) {
+        put64(image, opt + 72, 0x100000);
+        put64(image, opt + 80, 0x1000);
+        put64(image, opt + 88, 0x100000);
+        put64(image, opt + 96, 0x1000);
+        put32(image, opt + 108, 16);
+        dataDirectories = opt + 112;
+    } else {
+        put32(image, opt + 72, 0x100000);
+        put32(image, opt + 76, 0x1000);
+        put32(image, opt + 80, 0x100000);
+        put32(image, opt + 84, 0x1000);
+        put32(image, opt + 92, 16);
+        dataDirectories = opt + 96;
+    }
+
+    auto putDirectory = [&](std::size_t kind, std::uint32_t address, std::uint32_t size) {
+        put32(image, dataDirectories + kind * 8, address);
+        put32(image, dataDirectories + kind * 8 + 4, size);
+    };
+    if (spec.loadConfigSize != 0) {
+        putDirectory(kDirLoadConfig, kRdataRva, spec.loadConfigSize);
+    }
+    if (debugCount != 0) {
+        putDirectory(kDirDebug, kRdataRva + debugOffset, debugCount * kDebugEntrySize);
+    }
+    if (pdataSize != 0) {
+        putDirectory(kDirException, kRdataRva + pdataOffset, pdataSize);
+    }
+    if (spec.dotNET) {
+        putDirectory(kDirComDescriptor, kRdataRva + clrOffset, 72);
+    }
+    if (!spec.imports.empty()) {
+        putDirectory(kDirImport, kRdataRva + importsOffset, 2 * kImportDescriptorSize);
+    }
+    if (!spec.delayImports.empty()) {
+        putDirectory(kDirDelayImport, kRdataRva + delayImportsOffset,
+                     2 * kDelayImportDescriptorSize);
+    }
+
+    // The section table.
+    std::size_t sections = opt + sizeOfOptionalHeader;
+    putSection(image, sections, ".text", textSize, kTextRva, textRawSize, kSizeOfHeaders,
+               0x60000020);
+    putSection(image, sections + 40, ".rdata", static_cast<std::uint32_t>(rdata.size()),
+               kRdataRva, rdataRawSize, rdataRaw, 0x40000040);
+    putSection(image, sections + 80, ".data", spec.dataSize, dataRva, dataRawSize, dataRaw,
+               0xc0000040);
+
+    // .text is a single `ret` (which the guard tables, and the cookie checks, point at), then
+    // the functions, padded with `int3`s.
+    std::fill_n(&image[kSizeOfHeaders], textRawSize, 0xcc);
+    image[kSizeOfHeaders] = 0xc3;
+    std::uint64_t cookie = imageBase + dataRva;
+    for (std::uint32_t i = 0; i < functions; ++i) {
+        std::uint32_t rva = kTextRva + kFunctionsOffset + i * kFunctionSize;
+        std::vector<std::uint8_t> code;
+        if (spec.pe64) {
+            // sub rsp, 28h ... add rsp, 28h; ret
+            code = {0x48, 0x83, 0xec, 0x28};
+            if (i < gsFunctions) {
+                // mov rax, [rip + cookie]; xor rax, rsp; mov [rsp + 20h], rax
+                // mov rcx, [rsp + 20h]; xor rcx, rsp; call <ret>
+                code.insert(code.end(), {0x48, 0x8b, 0x05, 0, 0, 0, 0, 0x48, 0x33, 0xc4, 0x48,
+                                         0x89, 0x44, 0x24, 0x20, 0x48, 0x8b, 0x4c, 0x24, 0x20,
+                                         0x48, 0x33, 0xcc, 0xe8, 0, 0, 0, 0});
+                put32(code, 7, static_cast<std::uint32_t>(cookie - imageBase - (rva + 11)));
+                put32(code, 28, kTextRva - (rva + 32));
+            }
+            code.insert(code.end(), {0x48, 0x83, 0xc4, 0x28, 0xc3});
+        } else {
+            // push ebp; mov ebp, esp ... mov esp, ebp; pop ebp; ret
+            code = {0x55, 0x8b, 0xec};
+            if (i < gsFunctions) {
+                // sub esp, 10h; mov eax, [cookie]; xor eax, ebp; mov [ebp - 4], eax
+                // mov ecx, [ebp - 4]; xor ecx, ebp; call <ret>
+                code.insert(code.end(), {0x83, 0xec, 0x10, 0xa1, 0, 0, 0, 0, 0x33, 0xc5, 0x89,
+                                         0x45, 0xfc, 0x8b, 0x4d, 0xfc, 0x33, 0xcd, 0xe8, 0, 0,
+                                         0, 0});
+                put32(code, 7, static_cast<std::uint32_t>(cookie));
+                put32(code, 22, kTextRva - (rva + 26));
+            }
+            code.insert(code.end(), {0x8b, 0xe5, 0x5d, 0xc3});
+        }
+        std::copy(code.begin(), code.end(), image.begin() + kSizeOfHeaders + (rva - kTextRva));
+    }
+
+    std::copy(rdata.begin(), rdata.end(), image.begin() + rdataRaw);
+
+    // .data is filled with cheap, deterministic noise, so that it doesn't compress away.
+    std::uint64_t state = 0x9e3779b97f4a7c15ull ^ spec.dataSize;
+    for (std::uint32_t i = 0; i < spec.dataSize; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        image[dataRaw + i] = static_cast<std::uint8_t>(state);
+    }
+
+    // The certificate table lives at the end of the file, and is addressed by file offset
+    // rather than RVA. Its PKCS#7 blob is a SignedData ContentInfo with no content.
+    if (spec.signature) {
+        constexpr std::uint8_t kSignedData[] = {
+            0x30, 0x0f, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7,
+            0x0d, 0x01, 0x07, 0x02, 0xa0, 0x02, 0x30, 0x00,
+        };
+        std::uint32_t offset = alignUp(static_cast<std::uint32_t>(image.size()), 8);
+        std::uint32_t length = 8 + sizeof(kSignedData);
+        image.resize(offset + alignUp(length, 8));
+        put32(image, offset, length);
+        put16(image, offset + 4, 0x0200);  // WIN_CERT_REVISION_2_0
+        put16(image, offset + 6, 0x0002);  // WIN_CERT_TYPE_PKCS_SIGNED_DATA
+        std::copy(std::begin(kSignedData), std::end(kSignedData), image.begin() + offset + 8);
+        putDirectory(kDirSecurity, offset, alignUp(length, 8));
+    }
+
+    return image;
+}
+
+}  // namespace checksec::corpus
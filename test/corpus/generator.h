@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace checksec::corpus {
+
+/**
+ * The shape of a synthetic PE image.
+ */
+struct ImageSpec {
+    /**
+     * Whether to build a PE32+ (x86_64) image rather than a PE32 (x86) one.
+     */
+    bool pe64 = false;
+
+    std::uint16_t dllCharacteristics = 0;
+
+    /**
+     * Whether to set `IMAGE_FILE_RELOCS_STRIPPED`.
+     */
+    bool relocsStripped = false;
+
+    /**
+     * The size of the load config directory, or 0 for none. Sizes smaller or larger than
+     * pe-parse's load config structures produce undersized and oversized load configs.
+     */
+    std::uint32_t loadConfigSize = 0;
+
+    std::uint32_t guardFlags = 0;
+    bool securityCookie = false;
+    bool seHandlers = false;
+
+    /**
+     * The number of entries in the CFG function table and the EH continuation table. Entries
+     * are as wide as the `IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK` bits of `guardFlags` say.
+     */
+    std::uint32_t cfgFunctions = 0;
+    std::uint32_t ehContinuations = 0;
+
+    /**
+     * Whether the guard tables' addresses point past the end of the image.
+     */
+    bool guardTablesOutOfBounds = false;
+
+    /**
+     * Whether to set the XFG check function pointer.
+     */
+    bool xfg = false;
+
+    /**
+     * The number of (uninteresting) debug directory entries.
+     */
+    std::uint32_t debugDirectories = 0;
+
+    /**
+     * Whether to add an `IMAGE_DEBUG_TYPE_EX_DLLCHARACTERISTICS` entry with the CET compatible
+     * bit set.
+     */
+    bool cetCompat = false;
+
+    /**
+     * Whether to also set the CET strict mode bit, alongside the CET compatible one.
+     */
+    bool cetStrict = false;
+
+    /**
+     * Whether to add a CLR (.NET) header.
+     */
+    bool dotNET = false;
+
+    /**
+     * The number of functions in the code section with and without stack cookie
+     * instrumentation, in that order; at most 100 in total. x86_64 images also get an exception
+     * directory listing them.
+     */
+    std::uint32_t gsFunctions = 0;
+    std::uint32_t plainFunctions = 0;
+
+    /**
+     * The functions that the image imports by name from `KERNEL32.dll`, and those that it
+     * delay-loads from `USER32.dll`.
+     */
+    std::vector<std::string> imports;
+    std::vector<std::string> delayImports;
+
+    /**
+     * The size of the image's data section, which is filled with deterministic noise.
+     */
+    std::uint32_t dataSize = 0x200;
+
+    /**
+     * Whether to attach a certificate table containing a `PKCS_SIGNED_DATA` certificate. The
+     * certificate is well-formed at the `WIN_CERTIFICATE` level but never verifies.
+     */
+    bool signature = false;
+};
+
+/**
+ * Options that bound randomly generated specs.
+ */
+struct SpecLimits {
+    std::uint32_t maxDataSize = 64 * 1024;
+    bool signatures = false;
+};
+
+/**
+ * @return a random spec, drawn deterministically from `rng`
+ *
+ * @note Only `rng`'s raw output is used (not `<random>`'s distributions, which vary between
+ *       standard libraries), so a seed produces the same corpus everywhere.
+ */
+ImageSpec randomSpec(std::mt19937_64& rng, const SpecLimits& limits);
+
+/**
+ * @return a valid PE image built from `spec`
+ */
+std::vector<std::uint8_t> buildImage(const ImageSpec& spec);
+
+}  // namespace checksec::corpus
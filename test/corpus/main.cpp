@@ -0,0 +1,78 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "generator.h"
+#include "vendor/argh.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+// NOTE: Keeps directories small enough to list quickly, even for million-file corpora.
+constexpr std::uint64_t kFilesPerDirectory = 1000;
+
+void usage(char* argv[]) {
+    std::cerr << "Syntax : " << argv[0]
+              << " [--count N] [--seed S] [--max-data-size BYTES] [--signatures] <dir>"
+              << "\n";
+    std::cerr << "Writes N (default: 1000) synthetic PEs under <dir>, reproducibly from seed S "
+                 "(default: 0)"
+              << "\n";
+    std::cerr << "  --max-data-size BYTES bounds the size of each image's data section "
+                 "(default: 65536)"
+              << "\n";
+    std::cerr << "  --signatures will attach (unverifiable) Authenticode certificates to some "
+                 "images"
+              << "\n";
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    argh::parser cmdl;
+    cmdl.add_params({"--count", "--seed", "--max-data-size"});
+    cmdl.parse(argc, argv);
+
+    std::uint64_t count = 1000;
+    std::uint64_t seed = 0;
+    checksec::corpus::SpecLimits limits;
+    limits.signatures = cmdl["--signatures"];
+    if (cmdl.size() != 2 || (cmdl("--count") && !(cmdl("--count") >> count)) ||
+        (cmdl("--seed") && !(cmdl("--seed") >> seed)) ||
+        (cmdl("--max-data-size") && !(cmdl("--max-data-size") >> limits.maxDataSize))) {
+        usage(argv);
+        return 1;
+    }
+
+    fs::path root = cmdl[1];
+    std::mt19937_64 rng(seed);
+    std::uint64_t bytes = 0;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        std::ostringstream directory, name;
+        directory << std::setw(4) << std::setfill('0') << i / kFilesPerDirectory;
+        name << std::setw(7) << std::setfill('0') << i << ".exe";
+
+        fs::path path = root / directory.str();
+        if (i % kFilesPerDirectory == 0) {
+            std::error_code ec;
+            fs::create_directories(path, ec);
+            if (ec) {
+                std::cerr << "Err: couldn't create " << path << ": " << ec.message() << "\n";
+                return 2;
+            }
+        }
+
+        auto image = checksec::corpus::buildImage(checksec::corpus::randomSpec(rng, limits));
+        std::ofstream file(path / name.str(), std::ios::binary);
+        if (!file.write(reinterpret_cast<const char*>(image.data()), image.size())) {
+            std::cerr << "Err: couldn't write " << (path / name.str()) << "\n";
+            return 2;
+        }
+        bytes += image.size();
+    }
+
+    std::cerr << "Wrote " << count << " images (" << bytes << " bytes) under " << root << "\n";
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include "gtest/gtest.h"
+
+#include <checksec.h>
+
+#include "cli/store.h"
+#include "temp-file.h"
+
+#include <cstring>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using checksec::Mitigation;
+using checksec::MitigationPresence;
+using checksec::MitigationSummary;
+using checksec::test::TempFile;
+
+namespace {
+/**
+ * @return `rows` summaries with pseudo-random presences, the same on every run
+ */
+std::vector<MitigationSummary> randomSummaries(std::size_t rows) {
+    std::mt19937 rng(static_cast<std::mt19937::result_type>(rows));
+    std::uniform_int_distribution<int> presence(0, 3);
+    std::vector<MitigationSummary> summaries(rows);
+    for (auto &summary : summaries) {
+        for (std::size_t i = 0; i < checksec::kMitigationCount; ++i) {
+            summary.set(static_cast<Mitigation>(i),
+                        static_cast<MitigationPresence>(presence(rng)));
+        }
+    }
+    return summaries;
+}
+
+std::string rowPath(std::size_t row) { return "C:\\corpus\\file-" + std::to_string(row) + ".exe"; }
+
+/**
+ * @return the bytes of a store holding `summaries`
+ */
+std::string storeBytes(const std::vector<MitigationSummary> &summaries) {
+    checksec::cli::ResultStoreWriter writer;
+    for (std::size_t row = 0; row < summaries.size(); ++row) {
+        writer.add(rowPath(row), summaries[row]);
+    }
+    std::ostringstream os;
+    EXPECT_TRUE(writer.write(os));
+    return os.str();
+}
+
+bool is(const MitigationSummary &s, Mitigation m, MitigationPresence p) {
+    return s.presence(m) == p;
+}
+}  // namespace
+
+TEST(ResultStore, RoundTrip) {
+    // Row counts on either side of a word, and past the end of the first block of words.
+    for (std::size_t rows : {0, 1, 31, 32, 33, 100, 8192 + 40}) {
+        auto summaries = randomSummaries(rows);
+        TempFile file("winchecksec-store-roundtrip.wcs");
+        file.write(storeBytes(summaries));
+
+        checksec::cli::ResultStore store(file.path());
+        ASSERT_EQ(store.rows(), rows);
+        for (std::size_t row = 0; row < rows; ++row) {
+            ASSERT_EQ(store.path(row), rowPath(row)) << row;
+            for (std::size_t i = 0; i < checksec::kMitigationCount; ++i) {
+                auto mitigation = static_cast<Mitigation>(i);
+                ASSERT_EQ(store.presence(mitigation, row), summaries[row].presence(mitigation))
+                    << row << " " << i;
+            }
+        }
+    }
+}
+
+TEST(ResultStore, QueryMatchesRowByRow) {
+    using Predicate = std::function<bool(const MitigationSummary &)>;
+    const std::pair<const char *, Predicate> cases[] = {
+        {"", [](auto &) { return true; }},
+        {" \t ", [](auto &) { return true; }},
+        {"cfg=Present",
+         [](auto &s) { return is(s, Mitigation::CFG, MitigationPresence::Present); }},
+        {"CFG=notpresent",
+         [](auto &s) { return is(s, Mitigation::CFG, MitigationPresence::NotPresent); }},
+        {"gs!=Present",
+         [](auto &s) { return !is(s, Mitigation::GS, MitigationPresence::Present); }},
+        {"!gs=Present",
+         [](auto &s) { return !is(s, Mitigation::GS, MitigationPresence::Present); }},
+        {"!!aslr=NotImplemented",
+         [](auto &s) { return is(s, Mitigation::ASLR, MitigationPresence::NotImplemented); }},
+        {"!nx=Present && !cfg!=NotApplicable",
+         [](auto &s) {
+             return !is(s, Mitigation::NX, MitigationPresence::Present) &&
+                    is(s, Mitigation::CFG, MitigationPresence::NotApplicable);
+         }},
+        // `&&` binds tighter than `||`, and parentheses override both.
+        {"nx=Present || cfg=Present && gs=NotPresent",
+         [](auto &s) {
+             return is(s, Mitigation::NX, MitigationPresence::Present) ||
+                    (is(s, Mitigation::CFG, MitigationPresence::Present) &&
+                     is(s, Mitigation::GS, MitigationPresence::NotPresent));
+         }},
+        {"(nx=Present || cfg=Present) && gs=NotPresent",
+         [](auto &s) {
+             return (is(s, Mitigation::NX, MitigationPresence::Present) ||
+                     is(s, Mitigation::CFG, MitigationPresence::Present)) &&
+                    is(s, Mitigation::GS, MitigationPresence::NotPresent);
+         }},
+        {"!(seh=Present || safeSEH=Present)",
+         [](auto &s) {
+             return !is(s, Mitigation::SEH, MitigationPresence::Present) &&
+                    !is(s, Mitigation::SafeSEH, MitigationPresence::Present);
+         }},
+        {"aslr=Present && aslr!=Present", [](auto &) { return false; }},
+    };
+
+    for (std::size_t rows : {0, 1, 31, 32, 33, 100, 8192 + 40}) {
+        auto summaries = randomSummaries(rows);
+        TempFile file("winchecksec-store-query.wcs");
+        file.write(storeBytes(summaries));
+        checksec::cli::ResultStore store(file.path());
+
+        for (const auto &[filter, predicate] : cases) {
+            std::vector<std::size_t> expected;
+            for (std::size_t row = 0; row < rows; ++row) {
+                if (predicate(summaries[row])) {
+                    expected.push_back(row);
+                }
+            }
+
+            checksec::cli::StoreQuery query(filter);
+            std::vector<std::size_t> matched;
+            auto matches = query.forEach(store, [&](std::size_t row) { matched.push_back(row); });
+            EXPECT_EQ(matched, expected) << "'" << filter << "' over " << rows << " rows";
+            EXPECT_EQ(matches, expected.size()) << filter;
+            EXPECT_EQ(query.count(store), expected.size()) << filter;
+        }
+    }
+}
+
+TEST(ResultStore, MalformedQueries) {
+    for (const char *filter : {"cfg", "cfg=", "cfg=Maybe", "bogus=Present", "cfg=Present &&",
+                               "(cfg=Present", "cfg=Present)", "!", "cfg==Present"}) {
+        EXPECT_THROW(checksec::cli::StoreQuery{filter}, checksec::ChecksecError) << filter;
+    }
+}
+
+TEST(ResultStore, RejectsCorruptStores) {
+    auto valid = storeBytes(randomSummaries(40));
+    // NOTE: The header is 32 bytes: magic, version, mitigation count, reserved, rows and path
+    // bytes. The path offsets follow it.
+    constexpr std::size_t kMitigationCountAt = 12;
+    constexpr std::size_t kOffsetsAt = 32;
+
+    auto patch = [&](std::size_t at, auto value) {
+        auto bytes = valid;
+        std::memcpy(&bytes[at], &value, sizeof(value));
+        return bytes;
+    };
+
+    const std::pair<const char *, std::string> corrupt[] = {
+        {"empty", ""},
+        {"truncated header", valid.substr(0, 20)},
+        {"header only", valid.substr(0, kOffsetsAt)},
+        {"truncated columns", valid.substr(0, valid.size() - 8)},
+        {"bad magic", patch(0, 'X')},
+        {"bad version", patch(8, std::uint32_t{2})},
+        {"mitigation count",
+         patch(kMitigationCountAt, static_cast<std::uint16_t>(checksec::kMitigationCount - 1))},
+        {"nonzero first offset", patch(kOffsetsAt, std::uint64_t{1})},
+        {"unsorted offsets", patch(kOffsetsAt + 8 * 2, std::uint64_t{1})},
+        {"last offset past the paths", patch(kOffsetsAt + 8 * 40, std::uint64_t{1} << 40)},
+        {"row count past the file", patch(16, std::uint64_t{1} << 40)},
+    };
+
+    TempFile file("winchecksec-store-corrupt.wcs");
+    for (const auto &[name, bytes] : corrupt) {
+        file.write(bytes);
+        EXPECT_THROW(checksec::cli::ResultStore{file.path()}, checksec::ChecksecError) << name;
+    }
+
+    // The unpatched store still loads.
+    file.write(valid);
+    EXPECT_NO_THROW(checksec::cli::ResultStore{file.path()});
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace checksec::test {
+
+/**
+ * A file in the temporary directory, removed once the test is done with it.
+ */
+class TempFile {
+   public:
+    explicit TempFile(const std::string &name)
+        : path_((std::filesystem::temp_directory_path() / name).string()) {
+        std::remove(path_.c_str());
+    }
+    ~TempFile() { std::remove(path_.c_str()); }
+
+    // can't make copies of TempFile
+    TempFile(const TempFile &) = delete;
+    TempFile &operator=(const TempFile &) = delete;
+
+    const std::string &path() const { return path_; }
+
+    void write(const std::string &contents) const {
+        std::ofstream(path_, std::ios::binary) << contents;
+    }
+
+    /**
+     * @return the file's contents, or an empty string if it doesn't exist
+     */
+    std::string read() const {
+        std::ifstream file(path_, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+   private:
+    std::string path_;
+};
+
+}  // namespace checksec::test
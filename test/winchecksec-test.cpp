@@ -2,6 +2,15 @@
 
 #include <checksec.h>
 
+#include "corpus/generator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
 TEST(Winchecksec, NoDynamicBase32) {
     auto *path = WINCHECKSEC_TEST_ASSETS "/32/pegoat-no-dynamicbase.exe";
 
@@ -165,3 +174,664 @@ TEST(Winchecksec, CetCompat64) {
 
     EXPECT_TRUE(checksec.isCetCompat());
 }
+
+TEST(Winchecksec, HeadersOnlyMatchesFull) {
+    // A header-only load should reach the same conclusions as a full one.
+    for (auto *path : {
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat.exe",
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat-authenticode.exe",
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat-no-safeseh.exe",
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat-yes-cfg.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat-authenticode.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat-cetcompat.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat-no-gs.exe",
+         }) {
+        auto full = checksec::Checksec(path, checksec::LoadMode::Full);
+        auto partial = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+
+        EXPECT_EQ(full.isASLR().presence, partial.isASLR().presence) << path;
+        EXPECT_EQ(full.isHighEntropyVA().presence, partial.isHighEntropyVA().presence) << path;
+        EXPECT_EQ(full.isNX().presence, partial.isNX().presence) << path;
+        EXPECT_EQ(full.isCFG().presence, partial.isCFG().presence) << path;
+        EXPECT_EQ(full.isRFG().presence, partial.isRFG().presence) << path;
+        EXPECT_EQ(full.isSafeSEH().presence, partial.isSafeSEH().presence) << path;
+        EXPECT_EQ(full.isGS().presence, partial.isGS().presence) << path;
+        EXPECT_EQ(full.isDotNET().presence, partial.isDotNET().presence) << path;
+        EXPECT_EQ(full.isCetCompat().presence, partial.isCetCompat().presence) << path;
+        EXPECT_EQ(full.isCFGTable().presence, partial.isCFGTable().presence) << path;
+        EXPECT_EQ(full.isEHContinuation().presence, partial.isEHContinuation().presence) << path;
+        EXPECT_EQ(full.isAuthenticode().presence, partial.isAuthenticode().presence) << path;
+    }
+}
+
+TEST(Winchecksec, HeadersOnlyMissingFile) {
+    EXPECT_THROW(checksec::Checksec(WINCHECKSEC_TEST_ASSETS "/nonexistent.exe",
+                                    checksec::LoadMode::HeadersOnly),
+                 checksec::ChecksecError);
+}
+
+TEST(Winchecksec, FromBuffer) {
+    // Checking an in-memory image should reach the same conclusions as checking the file.
+    for (auto *path : {
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat-yes-cfg.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat-authenticode.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat-cetcompat.exe",
+         }) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<std::uint8_t> data(std::istreambuf_iterator<char>(file), {});
+
+        auto fromFile = checksec::Checksec(path);
+        auto fromBuffer = checksec::Checksec(data.data(), data.size(), "label");
+
+        EXPECT_EQ(fromBuffer.filepath(), "label");
+        EXPECT_EQ(fromFile.summary(), fromBuffer.summary()) << path;
+    }
+
+    std::uint8_t garbage[] = {'M', 'Z', 0, 0};
+    EXPECT_THROW(checksec::Checksec(garbage, sizeof(garbage)), checksec::ChecksecError);
+}
+
+TEST(Winchecksec, SelectedChecks) {
+    auto *path = WINCHECKSEC_TEST_ASSETS "/64/pegoat.exe";
+
+    auto full = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+    auto headers = checksec::Checksec(
+        path, checksec::LoadMode::HeadersOnly,
+        checksec::checkMask(checksec::Mitigation::NX) |
+            checksec::checkMask(checksec::Mitigation::CFG));
+    auto gs = checksec::Checksec(path, checksec::LoadMode::HeadersOnly,
+                                 checksec::checkMask(checksec::Mitigation::GS));
+
+    EXPECT_EQ(headers.isNX().presence, full.isNX().presence);
+    EXPECT_EQ(headers.isCFG().presence, full.isCFG().presence);
+    EXPECT_EQ(headers.isGS().presence, checksec::MitigationPresence::NotImplemented);
+    EXPECT_EQ(headers.isAuthenticode().presence, checksec::MitigationPresence::NotImplemented);
+    EXPECT_EQ(gs.isGS().presence, full.isGS().presence);
+    EXPECT_EQ(gs.isNX().presence, checksec::MitigationPresence::NotImplemented);
+
+    // Header-only checks don't read the load config or debug directories at all.
+    EXPECT_EQ(headers.timings()[checksec::Phase::DebugDirectories], 0u);
+    EXPECT_LT(headers.timings().bytesRead, gs.timings().bytesRead);
+}
+
+TEST(Winchecksec, TargetMachine) {
+    auto checksec32 = checksec::Checksec(WINCHECKSEC_TEST_ASSETS "/32/pegoat.exe",
+                                         checksec::LoadMode::HeadersOnly);
+    auto checksec64 = checksec::Checksec(WINCHECKSEC_TEST_ASSETS "/64/pegoat.exe",
+                                         checksec::LoadMode::HeadersOnly);
+
+    EXPECT_EQ(checksec32.targetMachine(), peparse::IMAGE_FILE_MACHINE_I386);
+    EXPECT_FALSE(checksec32.is64Bit());
+    EXPECT_EQ(checksec64.targetMachine(), peparse::IMAGE_FILE_MACHINE_AMD64);
+    EXPECT_TRUE(checksec64.is64Bit());
+}
+
+TEST(Winchecksec, SyntheticImage64) {
+    checksec::corpus::ImageSpec spec;
+    spec.pe64 = true;
+    spec.dllCharacteristics = peparse::IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE |
+                              peparse::IMAGE_DLLCHARACTERISTICS_HIGH_ENTROPY_VA |
+                              peparse::IMAGE_DLLCHARACTERISTICS_NX_COMPAT |
+                              peparse::IMAGE_DLLCHARACTERISTICS_GUARD_CF;
+    spec.loadConfigSize = 256;
+    spec.guardFlags = 0x00020000 | 0x00040000;
+    spec.securityCookie = true;
+    spec.debugDirectories = 3;
+    spec.cetCompat = true;
+    auto image = checksec::corpus::buildImage(spec);
+
+    auto checksec = checksec::Checksec(image.data(), image.size());
+
+    EXPECT_TRUE(checksec.isASLR());
+    EXPECT_TRUE(checksec.isHighEntropyVA());
+    EXPECT_TRUE(checksec.isNX());
+    EXPECT_TRUE(checksec.isCFG());
+    EXPECT_TRUE(checksec.isRFG());
+    EXPECT_TRUE(checksec.isGS());
+    EXPECT_TRUE(checksec.isCetCompat());
+    EXPECT_FALSE(checksec.isDotNET());
+    EXPECT_EQ(checksec.isSafeSEH().presence, checksec::MitigationPresence::NotApplicable);
+}
+
+TEST(Winchecksec, SyntheticImageUndersizedLoadConfig32) {
+    checksec::corpus::ImageSpec spec;
+    spec.loadConfigSize = 64;
+    spec.securityCookie = true;
+    spec.seHandlers = true;
+    spec.dotNET = true;
+    auto image = checksec::corpus::buildImage(spec);
+
+    auto checksec = checksec::Checksec(image.data(), image.size());
+
+    // The cookie is the last field that fits.
+    EXPECT_TRUE(checksec.isGS());
+    EXPECT_EQ(checksec.isSafeSEH().explanation, checksec::impl::kShortLoadConfigSafeSEHExplanation);
+    EXPECT_EQ(checksec.isASLR().explanation, checksec::impl::kDotNETASLRExplanation);
+    EXPECT_FALSE(checksec.isCetCompat());
+}
+
+TEST(Winchecksec, SyntheticGuardTables) {
+    checksec::corpus::ImageSpec spec;
+    spec.pe64 = true;
+    spec.dllCharacteristics = peparse::IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE |
+                              peparse::IMAGE_DLLCHARACTERISTICS_GUARD_CF;
+    spec.loadConfigSize = 320;
+    spec.guardFlags = 0x00000100 | 0x00000400 | 0x00400000 | 0x00800000 | 0x10000000;
+    spec.cfgFunctions = 100;
+    spec.ehContinuations = 3;
+    spec.xfg = true;
+    spec.cetCompat = true;
+    spec.cetStrict = true;
+    {
+        auto image = checksec::corpus::buildImage(spec);
+
+        auto checksec = checksec::Checksec(image.data(), image.size());
+
+        EXPECT_TRUE(checksec.isCFGTable());
+        EXPECT_TRUE(checksec.isXFG());
+        EXPECT_TRUE(checksec.isEHContinuation());
+        EXPECT_TRUE(checksec.isCetStrict());
+
+        auto table = checksec.guardCFFunctionTable();
+        ASSERT_EQ(table.size(), 100u);
+        EXPECT_EQ(table.stride(), 5u);
+        EXPECT_EQ(table.rva(99), 0x1000u);
+        EXPECT_EQ(checksec.guardEHContinuationTable().size(), 3u);
+    }
+
+    // Tables that run off the end of the image aren't viewed.
+    spec.guardTablesOutOfBounds = true;
+    {
+        auto image = checksec::corpus::buildImage(spec);
+
+        auto checksec = checksec::Checksec(image.data(), image.size());
+
+        EXPECT_EQ(checksec.isCFGTable().explanation,
+                  checksec::impl::kCFGTableOutOfBoundsExplanation);
+        EXPECT_EQ(checksec.isEHContinuation().explanation,
+                  checksec::impl::kEHContinuationOutOfBoundsExplanation);
+        EXPECT_TRUE(checksec.guardCFFunctionTable().empty());
+    }
+
+    // A load config from before EH continuation and XFG, with CFG flagged but not instrumented.
+    spec.guardTablesOutOfBounds = false;
+    spec.loadConfigSize = 256;
+    spec.guardFlags = 0;
+    spec.cetStrict = false;
+    {
+        auto image = checksec::corpus::buildImage(spec);
+
+        auto checksec = checksec::Checksec(image.data(), image.size());
+
+        EXPECT_TRUE(checksec.isCFG());
+        EXPECT_FALSE(checksec.isCFGTable());
+        EXPECT_EQ(checksec.isXFG().explanation, checksec::impl::kShortLoadConfigXFGExplanation);
+        EXPECT_FALSE(checksec.isEHContinuation());
+        EXPECT_FALSE(checksec.isCetStrict());
+    }
+
+    spec.pe64 = false;
+    {
+        auto image = checksec::corpus::buildImage(spec);
+
+        auto checksec = checksec::Checksec(image.data(), image.size());
+
+        EXPECT_EQ(checksec.isEHContinuation().presence,
+                  checksec::MitigationPresence::NotApplicable);
+    }
+}
+
+TEST(Winchecksec, GuardTableHeadersOnly) {
+    // A partially loaded image reads its tables on demand, and finds the same entries.
+    auto *path = WINCHECKSEC_TEST_ASSETS "/64/pegoat-yes-cfg.exe";
+
+    auto full = checksec::Checksec(path, checksec::LoadMode::Full);
+    auto partial = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+    auto fullTable = full.guardCFFunctionTable();
+    auto partialTable = partial.guardCFFunctionTable();
+
+    EXPECT_TRUE(full.isCFGTable());
+    EXPECT_TRUE(partial.isCFGTable());
+    ASSERT_FALSE(fullTable.empty());
+    ASSERT_EQ(fullTable.size(), partialTable.size());
+    for (std::size_t i = 0; i < fullTable.size(); ++i) {
+        EXPECT_EQ(fullTable.rva(i), partialTable.rva(i)) << i;
+    }
+}
+
+namespace {
+constexpr checksec::impl::ScanBackend kScanBackends[] = {
+    checksec::impl::ScanBackend::Scalar,
+    checksec::impl::ScanBackend::SSE2,
+    checksec::impl::ScanBackend::AVX2,
+};
+
+const char *backendName(checksec::impl::ScanBackend backend) {
+    switch (backend) {
+        case checksec::impl::ScanBackend::Scalar: {
+            return "Scalar";
+        }
+        case checksec::impl::ScanBackend::SSE2: {
+            return "SSE2";
+        }
+        case checksec::impl::ScanBackend::AVX2: {
+            return "AVX2";
+        }
+        default: {
+            return "Auto";
+        }
+    }
+}
+}  // namespace
+
+TEST(Winchecksec, PatternScanner) {
+    // `a? 01 ff` and `02 03`, with matches straddling every vector boundary and at the very end.
+    checksec::impl::BytePattern first{{0xa0, 0x01, 0xff}, {0xf0, 0xff, 0xff}, 3};
+    checksec::impl::BytePattern second{{0x02, 0x03}, {0xff, 0xff}, 2};
+
+    std::vector<std::uint8_t> data(200, 0x01);
+    std::vector<std::size_t> expected;
+    for (std::size_t offset = 14; offset + 3 < data.size(); offset += 16) {
+        data[offset] = 0xa5;
+        data[offset + 2] = 0xff;
+        expected.push_back(offset);
+    }
+    data[data.size() - 4] = 0x02;
+    data[data.size() - 3] = 0x03;
+    // The first pattern, cut off by the end of the buffer.
+    data[data.size() - 2] = 0xa0;
+
+    for (auto backend : kScanBackends) {
+        if (!checksec::impl::PatternScanner::supports(backend)) {
+            std::cerr << "skipping unsupported backend " << backendName(backend) << "\n";
+            continue;
+        }
+        SCOPED_TRACE(backendName(backend));
+        checksec::impl::PatternScanner scanner({first, second}, backend);
+        EXPECT_EQ(scanner.backend(), backend);
+
+        std::vector<checksec::impl::PatternScanner::Match> matches;
+        scanner.scan(data.data(), data.size(), matches);
+
+        ASSERT_EQ(matches.size(), expected.size() + 1);
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            EXPECT_EQ(matches[i].offset, expected[i]);
+            EXPECT_EQ(matches[i].pattern, 0u);
+        }
+        EXPECT_EQ(matches.back().offset, data.size() - 4);
+        EXPECT_EQ(matches.back().pattern, 1u);
+    }
+}
+
+TEST(Winchecksec, PatternScannerBackendsAgree) {
+    // Overlapping patterns over a small alphabet, so that candidates are dense, at every size
+    // around the vector widths.
+    checksec::impl::BytePattern first{{0x01, 0x02, 0x01}, {0xff, 0xff, 0xff}, 3};
+    checksec::impl::BytePattern second{{0x02, 0x00}, {0xff, 0xfe}, 2};
+    checksec::impl::BytePattern third{{0x00, 0x01, 0x02, 0x03}, {0x00, 0xff, 0xff, 0x00}, 4};
+
+    std::vector<std::uint8_t> data(100);
+    std::uint32_t state = 1;
+    for (auto &byte : data) {
+        state = state * 1103515245 + 12345;
+        byte = static_cast<std::uint8_t>((state >> 16) % 3);
+    }
+
+    for (std::size_t size = 0; size <= data.size(); ++size) {
+        std::vector<checksec::impl::PatternScanner::Match> expected;
+        checksec::impl::PatternScanner({first, second, third}, checksec::impl::ScanBackend::Scalar)
+            .scan(data.data(), size, expected);
+
+        for (auto backend : kScanBackends) {
+            if (!checksec::impl::PatternScanner::supports(backend)) {
+                continue;
+            }
+            std::vector<checksec::impl::PatternScanner::Match> matches;
+            checksec::impl::PatternScanner({first, second, third}, backend)
+                .scan(data.data(), size, matches);
+
+            ASSERT_EQ(matches.size(), expected.size()) << backendName(backend) << " " << size;
+            for (std::size_t i = 0; i < expected.size(); ++i) {
+                EXPECT_EQ(matches[i].offset, expected[i].offset) << backendName(backend);
+                EXPECT_EQ(matches[i].pattern, expected[i].pattern) << backendName(backend);
+            }
+        }
+    }
+
+    // The scalar backend agrees with a naive search over the whole buffer.
+    std::vector<checksec::impl::PatternScanner::Match> expected;
+    const checksec::impl::BytePattern *patterns[] = {&first, &second, &third};
+    for (std::size_t offset = 0; offset < data.size(); ++offset) {
+        for (std::size_t k = 0; k < std::size(patterns); ++k) {
+            const auto &pattern = *patterns[k];
+            bool match = offset + pattern.size <= data.size();
+            for (std::size_t i = 0; match && i < pattern.size; ++i) {
+                match =
+                    (data[offset + i] & pattern.mask[i]) == (pattern.value[i] & pattern.mask[i]);
+            }
+            if (match) {
+                expected.push_back({offset, k});
+            }
+        }
+    }
+    std::vector<checksec::impl::PatternScanner::Match> matches;
+    checksec::impl::PatternScanner({first, second, third}, checksec::impl::ScanBackend::Scalar)
+        .scan(data.data(), data.size(), matches);
+    ASSERT_EQ(matches.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(matches[i].offset, expected[i].offset);
+        EXPECT_EQ(matches[i].pattern, expected[i].pattern);
+    }
+}
+
+TEST(Winchecksec, SyntheticGSInstrumentation) {
+    checksec::corpus::ImageSpec spec;
+    spec.loadConfigSize = 256;
+    spec.securityCookie = true;
+    spec.gsFunctions = 30;
+    spec.plainFunctions = 12;
+    for (bool pe64 : {false, true}) {
+        spec.pe64 = pe64;
+        auto image = checksec::corpus::buildImage(spec);
+
+        auto checksec = checksec::Checksec(image.data(), image.size());
+        auto gs = checksec.gsInstrumentation();
+
+        EXPECT_TRUE(checksec.isGS());
+        ASSERT_TRUE(gs.has_value());
+        EXPECT_EQ(gs->functions, 42u);
+        EXPECT_EQ(gs->instrumented, 30u);
+        EXPECT_EQ(gs->checks, 30u);
+    }
+
+    // Un-keying calls to anything other than the common check function aren't checks.
+    for (bool pe64 : {false, true}) {
+        spec.pe64 = pe64;
+        auto image = checksec::corpus::buildImage(spec);
+        std::vector<std::uint8_t> check = pe64 ? std::vector<std::uint8_t>{0x48, 0x33, 0xcc, 0xe8}
+                                               : std::vector<std::uint8_t>{0x33, 0xcd, 0xe8};
+        auto call = std::search(image.begin(), image.end(), check.begin(), check.end());
+        ASSERT_NE(call, image.end());
+        call[check.size()] += 16;
+
+        auto checksec = checksec::Checksec(image.data(), image.size());
+        auto gs = checksec.gsInstrumentation();
+        ASSERT_TRUE(gs.has_value());
+        EXPECT_EQ(gs->instrumented, 30u);
+        EXPECT_EQ(gs->checks, 29u);
+    }
+
+    // Nothing's scanned unless the GS check is selected.
+    auto image = checksec::corpus::buildImage(spec);
+    auto checksec = checksec::Checksec(image.data(), image.size(), "",
+                                       checksec::checkMask(checksec::Mitigation::NX));
+    EXPECT_FALSE(checksec.gsInstrumentation().has_value());
+}
+
+TEST(Winchecksec, RiskyApiCatalog) {
+    const auto *api = checksec::impl::findRiskyApi("SetProcessDEPPolicy");
+    ASSERT_NE(api, nullptr);
+    EXPECT_EQ(api->name, "SetProcessDEPPolicy");
+    EXPECT_EQ(api->risk, checksec::ApiRisk::MitigationPolicy);
+    EXPECT_EQ(checksec::impl::findRiskyApi("VirtualProtect")->risk,
+              checksec::ApiRisk::MemoryProtection);
+
+    // Near misses, and names that merely share a slot, aren't matched.
+    EXPECT_EQ(checksec::impl::findRiskyApi("VirtualProtec"), nullptr);
+    EXPECT_EQ(checksec::impl::findRiskyApi("virtualprotect"), nullptr);
+    EXPECT_EQ(checksec::impl::findRiskyApi("GetTickCount"), nullptr);
+    EXPECT_EQ(checksec::impl::findRiskyApi(""), nullptr);
+}
+
+TEST(Winchecksec, SyntheticRiskyImports) {
+    checksec::corpus::ImageSpec spec;
+    spec.imports = {"GetTickCount", "VirtualProtect", "CloseHandle", "GetProcAddress"};
+    spec.delayImports = {"SetProcessDEPPolicy"};
+    for (bool pe64 : {false, true}) {
+        spec.pe64 = pe64;
+        auto image = checksec::corpus::buildImage(spec);
+
+        auto checksec = checksec::Checksec(image.data(), image.size());
+        const auto &imports = checksec.riskyImports();
+
+        ASSERT_EQ(imports.size(), 3u);
+        EXPECT_EQ(imports[0].module, "KERNEL32.dll");
+        EXPECT_EQ(imports[0].function, "VirtualProtect");
+        EXPECT_EQ(imports[0].risk, checksec::ApiRisk::MemoryProtection);
+        EXPECT_FALSE(imports[0].delayLoaded);
+        EXPECT_EQ(imports[1].function, "GetProcAddress");
+        EXPECT_EQ(imports[1].risk, checksec::ApiRisk::DynamicResolution);
+        EXPECT_EQ(imports[2].module, "USER32.dll");
+        EXPECT_EQ(imports[2].function, "SetProcessDEPPolicy");
+        EXPECT_EQ(imports[2].risk, checksec::ApiRisk::MitigationPolicy);
+        EXPECT_TRUE(imports[2].delayLoaded);
+    }
+
+    // No imports, no findings.
+    spec.imports.clear();
+    spec.delayImports.clear();
+    auto image = checksec::corpus::buildImage(spec);
+    EXPECT_TRUE(checksec::Checksec(image.data(), image.size()).riskyImports().empty());
+}
+
+TEST(Winchecksec, RiskyImportsHeadersOnly) {
+    // A partially loaded image reads its import tables on demand, and finds the same imports.
+    for (auto *path : {
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat.exe",
+         }) {
+        auto full = checksec::Checksec(path, checksec::LoadMode::Full);
+        auto partial = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+        const auto &fullImports = full.riskyImports();
+        const auto &partialImports = partial.riskyImports();
+
+        // The MSVC runtime installs its own unhandled exception filter.
+        ASSERT_FALSE(fullImports.empty()) << path;
+        ASSERT_EQ(fullImports.size(), partialImports.size()) << path;
+        for (std::size_t i = 0; i < fullImports.size(); ++i) {
+            EXPECT_EQ(fullImports[i].module, partialImports[i].module) << path;
+            EXPECT_EQ(fullImports[i].function, partialImports[i].function) << path;
+        }
+        EXPECT_LT(partial.timings().bytesRead, full.timings().bytesRead) << path;
+    }
+}
+
+TEST(Winchecksec, SyntheticCorpus) {
+    checksec::corpus::SpecLimits limits;
+    limits.signatures = true;
+
+    // Every generated image is a valid PE, and the same seed produces the same images.
+    std::mt19937_64 rng(1234), again(1234);
+    for (int i = 0; i < 200; ++i) {
+        auto image = checksec::corpus::buildImage(checksec::corpus::randomSpec(rng, limits));
+        EXPECT_EQ(image, checksec::corpus::buildImage(checksec::corpus::randomSpec(again, limits)));
+
+        auto checksec = checksec::Checksec(image.data(), image.size());
+        EXPECT_FALSE(checksec.isAuthenticode()) << i;
+    }
+}
+
+TEST(Winchecksec, AuthenticodeDigest) {
+    // Unsigned images have no digest to report.
+    {
+        auto *path = WINCHECKSEC_TEST_ASSETS "/64/pegoat.exe";
+
+        auto checksec = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+
+        EXPECT_FALSE(checksec.isAuthenticode());
+        EXPECT_FALSE(checksec.authenticodeDigest());
+    }
+
+    // The digest is only reported alongside a successful verification, and is cached with it.
+    for (auto *path : {
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat-authenticode.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat-authenticode.exe",
+         }) {
+        auto checksec = checksec::Checksec(path);
+
+        bool signedImage = checksec.isAuthenticode();
+        EXPECT_EQ(signedImage, checksec.authenticodeDigest().has_value()) << path;
+        EXPECT_EQ(signedImage, static_cast<bool>(checksec.isAuthenticode())) << path;
+    }
+}
+
+TEST(Winchecksec, Detach) {
+    static_assert(std::is_trivially_copyable_v<checksec::DetachedResult>);
+
+    for (auto *path : {
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat-authenticode.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat-authenticode.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat-yes-cfg.exe",
+         }) {
+        auto checksec = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+        auto summary = checksec.summary();
+        auto digest = checksec.authenticodeDigest();
+
+        auto detached = checksec.detach();
+        auto detachedDigest = detached.authenticodeDigest();
+
+        EXPECT_EQ(detached.summary, summary) << path;
+        EXPECT_EQ(detached.targetMachine, checksec.targetMachine()) << path;
+        EXPECT_EQ(detached.is64Bit, checksec.is64Bit()) << path;
+        EXPECT_GT(detached.timings.bytesRead, 0u) << path;
+        ASSERT_EQ(digest.has_value(), detachedDigest.has_value()) << path;
+        if (digest) {
+            EXPECT_EQ(detachedDigest->algorithm, digest->algorithm) << path;
+            EXPECT_EQ(detachedDigest->digest, digest->digest) << path;
+        }
+
+        // The image is gone, but everything evaluated before it went is still there.
+        EXPECT_EQ(checksec.summary(), summary) << path;
+        EXPECT_TRUE(checksec.guardCFFunctionTable().empty()) << path;
+        EXPECT_FALSE(checksec.gsInstrumentation().has_value()) << path;
+        EXPECT_TRUE(checksec.riskyImports().empty()) << path;
+    }
+}
+
+TEST(Winchecksec, PlannedReads) {
+    auto readFile = [](const char *path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), {});
+    };
+    auto headerSize = [](const std::vector<std::uint8_t> &data) {
+        return std::min<std::size_t>(data.size(), checksec::impl::kHeaderReadSize);
+    };
+
+    // An unsigned image's load config and debug directories lie past its headers.
+    {
+        auto data = readFile(WINCHECKSEC_TEST_ASSETS "/64/pegoat.exe");
+        auto ranges = checksec::Checksec::plannedReads(data.data(), headerSize(data), data.size());
+
+        EXPECT_FALSE(ranges.empty());
+        for (const auto &range : ranges) {
+            EXPECT_GE(range.offset, checksec::impl::kHeaderReadSize);
+            EXPECT_LE(range.offset + range.size, data.size());
+        }
+
+        // Checks that only need the headers don't read anything else.
+        EXPECT_TRUE(checksec::Checksec::plannedReads(data.data(), headerSize(data), data.size(),
+                                                     checksec::checkMask(checksec::Mitigation::NX))
+                        .empty());
+    }
+
+    // A signed image is read in full.
+    {
+        auto data = readFile(WINCHECKSEC_TEST_ASSETS "/64/pegoat-authenticode.exe");
+        auto ranges = checksec::Checksec::plannedReads(data.data(), headerSize(data), data.size());
+
+        ASSERT_EQ(ranges.size(), 1u);
+        EXPECT_EQ(ranges[0].offset, 0u);
+        EXPECT_EQ(ranges[0].size, data.size());
+    }
+
+    // Anything that isn't a PE gets no predictions.
+    {
+        std::vector<std::uint8_t> data(checksec::impl::kHeaderReadSize, 'A');
+        EXPECT_TRUE(
+            checksec::Checksec::plannedReads(data.data(), data.size(), data.size()).empty());
+    }
+}
+
+TEST(Winchecksec, Deadline) {
+    auto *path = WINCHECKSEC_TEST_ASSETS "/64/pegoat-authenticode.exe";
+
+    // A scan that starts past its deadline is abandoned, however the image is loaded.
+    {
+        checksec::ScopedDeadline deadline(std::chrono::steady_clock::now());
+        EXPECT_THROW(checksec::Checksec(path, checksec::LoadMode::HeadersOnly),
+                     checksec::TimeoutError);
+        EXPECT_THROW(checksec::Checksec(path, checksec::LoadMode::Full), checksec::TimeoutError);
+    }
+
+    // The deadline only lasts as long as its scope, and a distant one never fires.
+    {
+        checksec::ScopedDeadline deadline(std::chrono::steady_clock::now() +
+                                          std::chrono::hours(1));
+        auto checksec = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+        EXPECT_NO_THROW(checksec.summary());
+    }
+    EXPECT_NO_THROW(checksec::ScopedDeadline::check());
+
+    // A cancelled scan is abandoned at its next checkpoint, even partway through.
+    {
+        std::atomic<bool> cancelled{false};
+        checksec::ScopedDeadline deadline(std::nullopt, cancelled);
+        auto checksec = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+        EXPECT_NO_THROW(checksec::ScopedDeadline::check());
+
+        cancelled = true;
+        EXPECT_THROW(checksec.gsInstrumentation(), checksec::TimeoutError);
+        EXPECT_THROW(checksec::Checksec(path, checksec::LoadMode::Full), checksec::TimeoutError);
+    }
+    EXPECT_NO_THROW(checksec::ScopedDeadline::check());
+}
+
+TEST(Winchecksec, Timings) {
+    auto *path = WINCHECKSEC_TEST_ASSETS "/64/pegoat.exe";
+
+    auto checksec = checksec::Checksec(path, checksec::LoadMode::HeadersOnly);
+    const auto &timings = checksec.timings();
+
+    // A header-only load reads (and counts) only part of the file.
+    EXPECT_GT(timings.bytesRead, 0);
+    EXPECT_LT(timings.bytesRead, checksec::Checksec(path).timings().bytesRead);
+    EXPECT_GT(timings[checksec::Phase::Parse], 0);
+    EXPECT_EQ(timings[checksec::Phase::Serialize], 0);
+}
+
+TEST(Winchecksec, Summary) {
+    // The summary and the individual reports are two views of the same evaluation.
+    for (auto *path : {
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat.exe",
+             WINCHECKSEC_TEST_ASSETS "/32/pegoat-no-safeseh.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat.exe",
+             WINCHECKSEC_TEST_ASSETS "/64/pegoat-yes-cfg.exe",
+         }) {
+        auto checksec = checksec::Checksec(path);
+        const auto &summary = checksec.summary();
+
+        EXPECT_EQ(summary.presence(checksec::Mitigation::ASLR), checksec.isASLR().presence);
+        EXPECT_EQ(summary.presence(checksec::Mitigation::CFG), checksec.isCFG().presence);
+        EXPECT_EQ(summary.presence(checksec::Mitigation::SafeSEH), checksec.isSafeSEH().presence);
+        EXPECT_EQ(summary.presence(checksec::Mitigation::Authenticode),
+                  checksec.isAuthenticode().presence);
+
+        for (std::size_t i = 0; i < checksec::kMitigationCount; ++i) {
+            auto mitigation = static_cast<checksec::Mitigation>(i);
+            EXPECT_NE(summary.presence(mitigation), checksec::MitigationPresence::NotImplemented);
+            EXPECT_EQ(checksec.report(mitigation).description, checksec::description(mitigation));
+        }
+    }
+
+    // Explanations survive the trip through the summary.
+    {
+        auto *path = WINCHECKSEC_TEST_ASSETS "/64/pegoat.exe";
+
+        auto checksec = checksec::Checksec(path);
+
+        EXPECT_EQ(checksec.isSafeSEH().presence, checksec::MitigationPresence::NotApplicable);
+        EXPECT_TRUE(checksec.isSafeSEH().explanation);
+        EXPECT_FALSE(checksec.isNX().explanation);
+    }
+}